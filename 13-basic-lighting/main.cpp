@@ -14,6 +14,7 @@
 #include "gtc/type_ptr.hpp"
 
 #include "camera.h"
+#include "matrix_batch.h"
 #include "shader.h"
 
 #define WINDOW_WIDTH 800
@@ -204,9 +205,10 @@ int main() {
         reinterpret_cast<void*>(0 * sizeof(float)));
     glEnableVertexAttribArray(0);
 
-    unsigned int cubeModelLoc = glGetUniformLocation(cube_shader.ID, "model");
+    unsigned int cubeModelViewLoc = glGetUniformLocation(cube_shader.ID, "modelView");
+    unsigned int cubeMvpLoc = glGetUniformLocation(cube_shader.ID, "mvp");
+    unsigned int cubeNormalMatrixLoc = glGetUniformLocation(cube_shader.ID, "normalMatrix");
     unsigned int cubeViewLoc = glGetUniformLocation(cube_shader.ID, "view");
-    unsigned int cubeProjectionLoc = glGetUniformLocation(cube_shader.ID, "projection");
 
     unsigned int lightModelLoc = glGetUniformLocation(light_shader.ID, "model");
     unsigned int lightViewLoc = glGetUniformLocation(light_shader.ID, "view");
@@ -238,7 +240,6 @@ int main() {
 
         glm::mat4 projection = glm::perspective(
             glm::radians(camera.zoom()), static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(cubeProjectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
         glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -248,7 +249,19 @@ int main() {
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, cube_position);
 
-        glUniformMatrix4fv(cubeModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        // The shader gets the products and the normal matrix ready instead
+        // of multiplying and inverting them for every vertex.
+        glm::mat4 model_view;
+        MultiplyMatrices(camera.view(), &model, 1, &model_view);
+        glm::mat4 mvp;
+        MultiplyMatrices(projection, &model_view, 1, &mvp);
+        NormalMatrix normal;
+        NormalMatrices(&model_view, 1, &normal);
+        glm::mat3 normal_matrix = ToMat3(normal);
+
+        glUniformMatrix4fv(cubeModelViewLoc, 1, GL_FALSE, glm::value_ptr(model_view));
+        glUniformMatrix4fv(cubeMvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+        glUniformMatrix3fv(cubeNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normal_matrix));
 
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
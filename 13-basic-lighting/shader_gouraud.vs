@@ -6,9 +6,12 @@ out vec3 ambient;
 out vec3 diffuse;
 out vec3 specular;
 
-uniform mat4 model;
+// Computed on the CPU, see matrix_batch.h.
+uniform mat4 modelView;
+uniform mat4 mvp;
+// transpose(inverse(mat3(modelView))).
+uniform mat3 normalMatrix;
 uniform mat4 view;
-uniform mat4 projection;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
@@ -16,10 +19,10 @@ uniform vec3 viewPos;
 uniform vec3 lightColor;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 
-    vec3 fNorm = mat3(transpose(inverse(view))) * mat3(transpose(inverse(model))) * aNorm;
-    vec3 fPos = vec3(view * model * vec4(aPos, 1.0));
+    vec3 fNorm = normalMatrix * aNorm;
+    vec3 fPos = vec3(modelView * vec4(aPos, 1.0));
     vec3 lPos = vec3(view * vec4(lightPos, 1.0));
 
     float ambientStrength = 0.1;
@@ -0,0 +1,130 @@
+#ifndef __INSTANCED_BATCH_H__
+#define __INSTANCED_BATCH_H__
+
+#include <cstddef>
+#include <vector>
+
+#include <glad.h>
+#include "glm.hpp"
+
+// Per instance attributes of an InstancedBatch.
+struct InstanceData {
+    glm::mat4 model;
+    // Index into whatever material table the shader has.
+    GLint material;
+};
+
+// Draws many copies of the same vertices with one instanced draw call. The
+// model matrix and material index of every copy live in an instance VBO
+// (attribute divisor 1) instead of being uploaded as uniforms per draw.
+//
+// The shader reads them as
+//   layout (location = first_location) in mat4 aModel;      // 4 locations
+//   layout (location = first_location + 4) in int aMaterial;
+//
+// Instances are drawn in the order they were added, so a sorted batch
+// (e.g. back to front for blending) keeps its order. The instance VBO is
+// only uploaded by the first draw after a change, and orphaned when it is
+// reused so that a batch rebuilt every frame does not wait on the GPU.
+class InstancedBatch {
+public:
+    // vao already describes the vertices, the instance attributes are
+    // added to it.
+    InstancedBatch(unsigned int vao, GLuint first_location) noexcept
+        : _vao(vao), _buffer(0), _capacity(0), _dirty(false) {
+        glGenBuffers(1, &_buffer);
+
+        glBindVertexArray(_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(first_location + i);
+            glVertexAttribPointer(first_location + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                reinterpret_cast<void*>(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(first_location + i, 1);
+        }
+        glEnableVertexAttribArray(first_location + 4);
+        glVertexAttribIPointer(first_location + 4, 1, GL_INT, sizeof(InstanceData),
+            reinterpret_cast<void*>(offsetof(InstanceData, material)));
+        glVertexAttribDivisor(first_location + 4, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    InstancedBatch(const InstancedBatch&) = delete;
+    InstancedBatch& operator=(const InstancedBatch&) = delete;
+
+    ~InstancedBatch() {
+        glDeleteBuffers(1, &_buffer);
+    }
+
+    void Clear() {
+        _instances.clear();
+        _dirty = true;
+    }
+
+    void Reserve(size_t count) {
+        _instances.reserve(count);
+    }
+
+    void Add(const glm::mat4& model, GLint material = 0) {
+        _instances.push_back({ model, material });
+        _dirty = true;
+    }
+
+    void Set(size_t index, const glm::mat4& model, GLint material = 0) {
+        _instances[index] = { model, material };
+        _dirty = true;
+    }
+
+    inline size_t size() const {
+        return _instances.size();
+    }
+
+    // Both bind the VAO the batch was created for and leave it bound.
+    void DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        if (_instances.empty()) {
+            return;
+        }
+        Upload();
+        glBindVertexArray(_vao);
+        glDrawArraysInstanced(mode, first, count, static_cast<GLsizei>(_instances.size()));
+    }
+
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        if (_instances.empty()) {
+            return;
+        }
+        Upload();
+        glBindVertexArray(_vao);
+        glDrawElementsInstanced(mode, count, type, indices,
+            static_cast<GLsizei>(_instances.size()));
+    }
+
+private:
+    unsigned int _vao;
+    unsigned int _buffer;
+    // Instances the buffer has room for.
+    size_t _capacity;
+    bool _dirty;
+    std::vector<InstanceData> _instances;
+
+    void Upload() {
+        if (!_dirty) {
+            return;
+        }
+        _dirty = false;
+
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        size_t size = _instances.size() * sizeof(InstanceData);
+        if (_instances.size() > _capacity) {
+            _capacity = _instances.size();
+            glBufferData(GL_ARRAY_BUFFER, size, _instances.data(), GL_DYNAMIC_DRAW);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, _instances.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif  // __INSTANCED_BATCH_H__
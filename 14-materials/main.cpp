@@ -4,6 +4,8 @@
 // change over time gives you a good understanding of Phong’s lighting model.
 
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
@@ -14,6 +16,7 @@
 #include "gtc/type_ptr.hpp"
 
 #include "camera.h"
+#include "instanced_batch.h"
 #include "shader.h"
 
 #define WINDOW_WIDTH 800
@@ -256,7 +259,28 @@ int main() {
         reinterpret_cast<void*>(0 * sizeof(float)));
     glEnableVertexAttribArray(0);
 
-    unsigned int cubeModelLoc = glGetUniformLocation(cube_shader.ID, "model");
+    // Every cube is an instance using its own material, the whole material
+    // table is uploaded once.
+    constexpr size_t cubes_count = sizeof(cube_positions) / sizeof(glm::vec3);
+    // NR_MATERIALS of shader.fs, a larger index would read past the array.
+    constexpr size_t shader_materials_count = 8;
+    static_assert(cubes_count <= shader_materials_count,
+                  "shader.fs declares fewer materials than there are cubes");
+    static_assert(cubes_count <= sizeof(cube_materials) / sizeof(Material),
+                  "every cube needs its own material");
+    // Owned here so that it is released before the context.
+    auto cubes = std::make_unique<InstancedBatch>(vertex_array, 2);
+    cube_shader.use();
+    for (size_t i = 0; i < cubes_count; i++) {
+        cubes->Add(glm::translate(glm::mat4(1.0f), cube_positions[i]), static_cast<GLint>(i));
+
+        std::string material = "materials[" + std::to_string(i) + "]";
+        cube_shader.setVec3(material + ".ambient", cube_materials[i].ambient);
+        cube_shader.setVec3(material + ".diffuse", cube_materials[i].diffuse);
+        cube_shader.setVec3(material + ".specular", cube_materials[i].specular);
+        cube_shader.setFloat(material + ".shininess", cube_materials[i].shininess);
+    }
+
     unsigned int cubeViewLoc = glGetUniformLocation(cube_shader.ID, "view");
     unsigned int cubeProjectionLoc = glGetUniformLocation(cube_shader.ID, "projection");
 
@@ -302,23 +326,7 @@ int main() {
 
         glUniformMatrix4fv(cubeViewLoc, 1, GL_FALSE, glm::value_ptr(camera.view()));
 
-        for (size_t i = 0; i < sizeof(cube_positions) / sizeof(glm::vec3); i++) {
-            const auto& cube_position = cube_positions[i];
-            const auto& cube_material = cube_materials[i];
-
-
-            cube_shader.setVec3("material.ambient", cube_material.ambient);
-            cube_shader.setVec3("material.diffuse", cube_material.diffuse);
-            cube_shader.setVec3("material.specular", cube_material.specular);
-            cube_shader.setFloat("material.shininess", cube_material.shininess);
-
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cube_position);
-
-            glUniformMatrix4fv(cubeModelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        cubes->DrawArrays(GL_TRIANGLES, 0, 36);
 
         // Light.
         light_shader.use();
@@ -338,6 +346,7 @@ int main() {
         glfwPollEvents();
     }
     
+    cubes.reset();
     glfwTerminate();
     return 0;
 }
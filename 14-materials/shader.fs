@@ -14,17 +14,22 @@ struct Light {
     vec3 specular;
 };
 
+#define NR_MATERIALS 8  // shader_materials_count in main.cpp
+
 out vec4 FragColor;
 
 in vec3 fNorm;
 in vec3 fPos;
+flat in int fMaterial;
 
-uniform Material material;
+uniform Material materials[NR_MATERIALS];
 uniform Light light;
 
 uniform vec3 viewPos;
 
 void main() {
+    Material material = materials[fMaterial];
+
     vec3 ambient = light.ambient * material.ambient;
 
     vec3 norm = normalize(fNorm);
@@ -1,16 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
+// Per instance, see instanced_batch.h.
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in int aMaterial;
 
 out vec3 fNorm;
 out vec3 fPos;
+flat out int fMaterial;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    fNorm = mat3(transpose(inverse(model))) * aNorm;
-    fPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    fNorm = mat3(transpose(inverse(aModel))) * aNorm;
+    fPos = vec3(aModel * vec4(aPos, 1.0));
+    fMaterial = aMaterial;
 }
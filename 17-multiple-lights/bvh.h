@@ -0,0 +1,305 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "glm.hpp"
+
+#include "bounds.h"
+#include "frustum.h"
+
+// Bounding volume hierarchy over the boxes of drawable objects, so that
+// culling them against a Frustum costs about the number of visible ones
+// (and the log of the total) instead of one test per object.
+//
+// Built top-down with the surface area heuristic, evaluated over a few
+// bins per axis. Nodes live in one array in depth-first order: the left
+// child of an interior node follows it, the right one is at index right.
+// A leaf covers up to kMaxLeafObjects entries of a permutation of the
+// objects, so its objects are contiguous in memory.
+//
+// Objects that move are Update()d with their new box, which grows or
+// shrinks the boxes of their ancestors (a refit) without rebuilding the
+// tree. The tree gets looser as objects travel far, call Build again then.
+class BVH {
+public:
+    struct Stats {
+        // Nodes whose box was tested against the frustum.
+        size_t nodes_tested = 0;
+        // Nodes accepted whole, their subtree was not tested.
+        size_t nodes_inside = 0;
+    };
+
+    static constexpr uint32_t kMaxLeafObjects = 4;
+
+    BVH() noexcept {}
+
+    explicit BVH(const std::vector<BoundingBox>& boxes) noexcept {
+        Build(boxes);
+    }
+
+    void Build(const std::vector<BoundingBox>& boxes) {
+        _boxes = boxes;
+        _nodes.clear();
+        _parents.clear();
+        _objects.resize(boxes.size());
+        _leaves.resize(boxes.size());
+        if (boxes.empty()) {
+            return;
+        }
+
+        _nodes.reserve(2 * boxes.size() / kMaxLeafObjects + 1);
+        _parents.reserve(_nodes.capacity());
+        std::vector<Primitive> primitives(boxes.size());
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            primitives[i] = { boxes[i], (boxes[i].min + boxes[i].max) * 0.5f, i };
+        }
+        BuildNode(primitives, 0, static_cast<uint32_t>(primitives.size()), kNoParent);
+        for (uint32_t i = 0; i < primitives.size(); i++) {
+            _objects[i] = primitives[i].object;
+        }
+    }
+
+    // Sets the box of object and refits its ancestors, stopping at the
+    // first one that does not change.
+    void Update(uint32_t object, const BoundingBox& box) {
+        _boxes[object] = box;
+        for (uint32_t node = _leaves[object]; node != kNoParent; node = _parents[node]) {
+            BoundingBox refitted = NodeBounds(node);
+            if (Equal(refitted, _nodes[node].box)) {
+                break;
+            }
+            _nodes[node].box = refitted;
+        }
+    }
+
+    // Appends the objects intersecting frustum to visible, in tree order.
+    void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) {
+        _stats = Stats();
+        if (_nodes.empty()) {
+            return;
+        }
+
+        _stack.clear();
+        _stack.push_back(0);
+        while (!_stack.empty()) {
+            const Node& node = _nodes[_stack.back()];
+            _stack.pop_back();
+            _stats.nodes_tested++;
+            Frustum::Containment containment = frustum.Classify(node.box);
+            if (containment == Frustum::Containment::kOutside) {
+                continue;
+            }
+            if (containment == Frustum::Containment::kInside) {
+                _stats.nodes_inside++;
+                AppendAll(node, visible);
+                continue;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (frustum.Intersects(_boxes[_objects[i]])) {
+                        visible.push_back(_objects[i]);
+                    }
+                }
+                continue;
+            }
+            // Left last, so that it is visited first.
+            _stack.push_back(node.right);
+            _stack.push_back(static_cast<uint32_t>(&node - _nodes.data()) + 1);
+        }
+    }
+
+    // Of the last Cull.
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+    inline size_t nodes() const {
+        return _nodes.size();
+    }
+
+private:
+    static constexpr uint32_t kNoParent = std::numeric_limits<uint32_t>::max();
+    static constexpr int kBins = 12;
+
+    struct Node {
+        BoundingBox box;
+        // Leaf: its objects are _objects[first, first + count).
+        // Interior (count 0): the right child is _nodes[right].
+        union {
+            uint32_t first;
+            uint32_t right;
+        };
+        uint32_t count;
+    };
+
+    // An object while the tree is built, partitioned in place.
+    struct Primitive {
+        BoundingBox box;
+        glm::vec3 center;
+        uint32_t object;
+    };
+
+    std::vector<Node> _nodes;
+    // Parent of every node, kNoParent for the root.
+    std::vector<uint32_t> _parents;
+    // Objects in leaf order.
+    std::vector<uint32_t> _objects;
+    // Leaf of every object.
+    std::vector<uint32_t> _leaves;
+    std::vector<BoundingBox> _boxes;
+    // Nodes left to visit by Cull, kept to not allocate every frame.
+    std::vector<uint32_t> _stack;
+    Stats _stats;
+
+    static BoundingBox Empty() {
+        return { glm::vec3(std::numeric_limits<float>::max()),
+                 glm::vec3(std::numeric_limits<float>::lowest()) };
+    }
+
+    static void Grow(BoundingBox& box, const BoundingBox& other) {
+        box.min = glm::min(box.min, other.min);
+        box.max = glm::max(box.max, other.max);
+    }
+
+    static float HalfArea(const BoundingBox& box) {
+        glm::vec3 size = box.max - box.min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    static bool Equal(const BoundingBox& a, const BoundingBox& b) {
+        return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+               a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+    }
+
+    // Union of the children or objects of node.
+    BoundingBox NodeBounds(uint32_t index) const {
+        const Node& node = _nodes[index];
+        BoundingBox box = Empty();
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                Grow(box, _boxes[_objects[i]]);
+            }
+        } else {
+            Grow(box, _nodes[index + 1].box);
+            Grow(box, _nodes[node.right].box);
+        }
+        return box;
+    }
+
+    void AppendAll(const Node& root, std::vector<uint32_t>& visible) const {
+        // Leaves of a subtree cover a contiguous range of _objects, between
+        // its leftmost and rightmost leaf.
+        const Node* first = &root;
+        while (first->count == 0) {
+            first = first + 1;
+        }
+        const Node* last = &root;
+        while (last->count == 0) {
+            last = &_nodes[last->right];
+        }
+        visible.insert(visible.end(), _objects.begin() + first->first,
+            _objects.begin() + last->first + last->count);
+    }
+
+    // Creates the node of objects [begin, end) and returns its index.
+    uint32_t BuildNode(std::vector<Primitive>& primitives, uint32_t begin, uint32_t end,
+                       uint32_t parent) {
+        uint32_t index = static_cast<uint32_t>(_nodes.size());
+        _nodes.push_back({ Empty(), { begin }, end - begin });
+        _parents.push_back(parent);
+
+        BoundingBox box = Empty();
+        BoundingBox center_box = Empty();
+        for (uint32_t i = begin; i < end; i++) {
+            Grow(box, primitives[i].box);
+            Grow(center_box, { primitives[i].center, primitives[i].center });
+        }
+        _nodes[index].box = box;
+
+        uint32_t middle = end - begin > kMaxLeafObjects
+            ? Split(primitives, begin, end, center_box) : begin;
+        if (middle == begin) {
+            for (uint32_t i = begin; i < end; i++) {
+                _leaves[primitives[i].object] = index;
+            }
+            return index;
+        }
+
+        _nodes[index].count = 0;
+        BuildNode(primitives, begin, middle, index);
+        uint32_t right = BuildNode(primitives, middle, end, index);
+        _nodes[index].right = right;
+        return index;
+    }
+
+    // Partitions [begin, end) along the binned split with the lowest SAH
+    // cost and returns where the right half starts, or begin when all the
+    // centers are in the same place.
+    uint32_t Split(std::vector<Primitive>& primitives, uint32_t begin, uint32_t end,
+                   const BoundingBox& center_box) {
+        struct Bin {
+            BoundingBox box = Empty();
+            uint32_t count = 0;
+        };
+
+        float best_cost = std::numeric_limits<float>::max();
+        int best_axis = -1;
+        int best_bin = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = center_box.max[axis] - center_box.min[axis];
+            if (extent <= 0.0f) {
+                continue;
+            }
+            float scale = kBins / extent;
+
+            Bin bins[kBins];
+            for (uint32_t i = begin; i < end; i++) {
+                int bin = std::min(kBins - 1,
+                    static_cast<int>((primitives[i].center[axis] - center_box.min[axis]) * scale));
+                bins[bin].count++;
+                Grow(bins[bin].box, primitives[i].box);
+            }
+
+            // Area times count of everything left of each split, then right.
+            float left_costs[kBins - 1];
+            BoundingBox left = Empty();
+            uint32_t left_count = 0;
+            for (int i = 0; i < kBins - 1; i++) {
+                Grow(left, bins[i].box);
+                left_count += bins[i].count;
+                left_costs[i] = left_count ? HalfArea(left) * left_count : 0.0f;
+            }
+            BoundingBox right = Empty();
+            uint32_t right_count = 0;
+            for (int i = kBins - 1; i > 0; i--) {
+                Grow(right, bins[i].box);
+                right_count += bins[i].count;
+                float cost = left_costs[i - 1] + (right_count ? HalfArea(right) * right_count : 0.0f);
+                if (right_count > 0 && right_count < end - begin && cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = i;
+                }
+            }
+        }
+
+        if (best_axis < 0) {
+            return begin;
+        }
+
+        float scale = kBins / (center_box.max[best_axis] - center_box.min[best_axis]);
+        auto middle = std::partition(primitives.begin() + begin, primitives.begin() + end,
+            [&](const Primitive& primitive) {
+                int bin = std::min(kBins - 1,
+                    static_cast<int>((primitive.center[best_axis] - center_box.min[best_axis]) * scale));
+                return bin < best_bin;
+            });
+        return static_cast<uint32_t>(middle - primitives.begin());
+    }
+};
+
+#endif  // __BVH_H__
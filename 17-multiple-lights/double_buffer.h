@@ -0,0 +1,37 @@
+#ifndef __DOUBLE_BUFFER_H__
+#define __DOUBLE_BUFFER_H__
+
+#include <cstddef>
+#include <vector>
+
+// Two arrays of the same size: jobs fill the back one for the next frame
+// while the render thread reads the front one, then Swap() hands the new
+// data over. Swap only once the writers are done, nothing is locked.
+template<typename T>
+class DoubleBuffer {
+public:
+    explicit DoubleBuffer(size_t size) noexcept
+        : _buffers{ std::vector<T>(size), std::vector<T>(size) }, _front(0) {}
+
+    inline const std::vector<T>& front() const {
+        return _buffers[_front];
+    }
+
+    inline std::vector<T>& back() {
+        return _buffers[1 - _front];
+    }
+
+    void Swap() {
+        _front = 1 - _front;
+    }
+
+    inline size_t size() const {
+        return _buffers[0].size();
+    }
+
+private:
+    std::vector<T> _buffers[2];
+    size_t _front;
+};
+
+#endif  // __DOUBLE_BUFFER_H__
@@ -0,0 +1,167 @@
+#ifndef __INSTANCED_BATCH_H__
+#define __INSTANCED_BATCH_H__
+
+#include <cstddef>
+#include <vector>
+
+#include <glad.h>
+#include "glm.hpp"
+
+#include "matrix_batch.h"
+
+// Draws many copies of the same vertices with one instanced draw call. The
+// model matrix, normal matrix and material index of every copy live in
+// instance VBOs (attribute divisor 1) instead of being uploaded as
+// uniforms per draw.
+//
+// The shader reads them as
+//   layout (location = first_location) in mat4 aModel;          // 4 locations
+//   layout (location = first_location + 4) in int aMaterial;
+//   layout (location = first_location + 5) in mat3 aNormalMatrix; // 3 locations
+//
+// Instances are kept as structure of arrays, one VBO per attribute, so
+// that the normal matrices are computed over all the models at once
+// (NormalMatrices) rather than inverted per vertex by the shader.
+//
+// Instances are drawn in the order they were added, so a sorted batch
+// (e.g. back to front for blending) keeps its order. The instance VBOs are
+// only uploaded by the first draw after a change, and orphaned when they
+// are reused so that a batch rebuilt every frame does not wait on the GPU.
+class InstancedBatch {
+public:
+    // vao already describes the vertices, the instance attributes are
+    // added to it.
+    InstancedBatch(unsigned int vao, GLuint first_location) noexcept
+        : _vao(vao), _model_buffer(0), _normal_buffer(0), _material_buffer(0),
+          _capacity(0), _dirty(false) {
+        glGenBuffers(1, &_model_buffer);
+        glGenBuffers(1, &_normal_buffer);
+        glGenBuffers(1, &_material_buffer);
+
+        glBindVertexArray(_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, _model_buffer);
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(first_location + i);
+            glVertexAttribPointer(first_location + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                reinterpret_cast<void*>(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(first_location + i, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, _material_buffer);
+        glEnableVertexAttribArray(first_location + 4);
+        glVertexAttribIPointer(first_location + 4, 1, GL_INT, sizeof(GLint), nullptr);
+        glVertexAttribDivisor(first_location + 4, 1);
+        // The w padding of each column is skipped.
+        glBindBuffer(GL_ARRAY_BUFFER, _normal_buffer);
+        for (GLuint i = 0; i < 3; i++) {
+            glEnableVertexAttribArray(first_location + 5 + i);
+            glVertexAttribPointer(first_location + 5 + i, 3, GL_FLOAT, GL_FALSE,
+                sizeof(NormalMatrix), reinterpret_cast<void*>(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(first_location + 5 + i, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    InstancedBatch(const InstancedBatch&) = delete;
+    InstancedBatch& operator=(const InstancedBatch&) = delete;
+
+    ~InstancedBatch() {
+        glDeleteBuffers(1, &_model_buffer);
+        glDeleteBuffers(1, &_normal_buffer);
+        glDeleteBuffers(1, &_material_buffer);
+    }
+
+    void Clear() {
+        _models.clear();
+        _materials.clear();
+        _dirty = true;
+    }
+
+    void Reserve(size_t count) {
+        _models.reserve(count);
+        _materials.reserve(count);
+    }
+
+    void Add(const glm::mat4& model, GLint material = 0) {
+        _models.push_back(model);
+        _materials.push_back(material);
+        _dirty = true;
+    }
+
+    void Set(size_t index, const glm::mat4& model, GLint material = 0) {
+        _models[index] = model;
+        _materials[index] = material;
+        _dirty = true;
+    }
+
+    inline size_t size() const {
+        return _models.size();
+    }
+
+    // Both bind the VAO the batch was created for and leave it bound.
+    void DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        if (_models.empty()) {
+            return;
+        }
+        Upload();
+        glBindVertexArray(_vao);
+        glDrawArraysInstanced(mode, first, count, static_cast<GLsizei>(_models.size()));
+    }
+
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        if (_models.empty()) {
+            return;
+        }
+        Upload();
+        glBindVertexArray(_vao);
+        glDrawElementsInstanced(mode, count, type, indices,
+            static_cast<GLsizei>(_models.size()));
+    }
+
+private:
+    unsigned int _vao;
+    unsigned int _model_buffer;
+    unsigned int _normal_buffer;
+    unsigned int _material_buffer;
+    // Instances the buffers have room for.
+    size_t _capacity;
+    bool _dirty;
+    std::vector<glm::mat4> _models;
+    std::vector<GLint> _materials;
+    // Derived from _models on upload.
+    std::vector<NormalMatrix> _normals;
+
+    void Upload() {
+        if (!_dirty) {
+            return;
+        }
+        _dirty = false;
+
+        _normals.resize(_models.size());
+        NormalMatrices(_models.data(), _models.size(), _normals.data());
+
+        bool grow = _models.size() > _capacity;
+        if (grow) {
+            _capacity = _models.size();
+        }
+        UploadBuffer(_model_buffer, _models.data(), sizeof(glm::mat4), grow);
+        UploadBuffer(_normal_buffer, _normals.data(), sizeof(NormalMatrix), grow);
+        UploadBuffer(_material_buffer, _materials.data(), sizeof(GLint), grow);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Uploads size() elements of stride bytes, reallocating the buffer to
+    // _capacity when it grows and orphaning it otherwise.
+    void UploadBuffer(unsigned int buffer, const void* data, size_t stride, bool grow) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t size = _models.size() * stride;
+        if (grow) {
+            glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, _capacity * stride, nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+        }
+    }
+};
+
+#endif  // __INSTANCED_BATCH_H__
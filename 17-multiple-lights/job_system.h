@@ -0,0 +1,247 @@
+#ifndef __JOB_SYSTEM_H__
+#define __JOB_SYSTEM_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing scheduler for data parallel loops, e.g. updating arrays of
+// transforms. Jobs must not touch OpenGL: the context belongs to the main
+// thread.
+//
+// A loop starts as a single job covering the whole range. Whoever runs a
+// job splits it in halves until it is no larger than the grain, keeping
+// one half and pushing the other on its own queue. Every worker pops the
+// newest job of its own queue (the smallest, still warm in its cache) and,
+// once that is empty, steals the oldest job (the largest) of another
+// queue. Threads waiting on a loop run jobs too instead of blocking.
+class JobSystem {
+private:
+    // A loop being run, owned by its Handle.
+    struct Loop {
+        std::function<void(size_t, size_t)> body;
+        size_t grain;
+        // Indices not run yet.
+        std::atomic<size_t> remaining;
+    };
+
+public:
+    // A loop started by Dispatch, to be waited on before it goes away.
+    class Handle {
+    public:
+        Handle() noexcept {}
+
+        inline bool done() const {
+            return !_loop || _loop->remaining.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        std::unique_ptr<Loop> _loop;
+    };
+
+    struct Stats {
+        size_t jobs = 0;
+        size_t steals = 0;
+    };
+
+    // threads_count threads take part in loops, the one waiting included,
+    // so threads_count - 1 workers are started.
+    explicit JobSystem(size_t threads_count) : _stopping(false), _queued(0), _next_queue(0) {
+        if (threads_count == 0) {
+            threads_count = 1;
+        }
+        // The last queue is shared by the threads that are not workers.
+        for (size_t i = 0; i < threads_count; i++) {
+            _queues.push_back(std::make_unique<Queue>());
+        }
+        _workers.reserve(threads_count - 1);
+        for (size_t i = 0; i + 1 < threads_count; i++) {
+            _workers.emplace_back(&JobSystem::run, this, i);
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+        for (auto& worker: _workers) {
+            worker.join();
+        }
+    }
+
+    // One thread per hardware thread.
+    static JobSystem& Shared() {
+        static JobSystem jobs(std::thread::hardware_concurrency());
+        return jobs;
+    }
+
+    // Starts body(begin, end) over chunks of [0, count) of at most grain
+    // indices and returns at once. body has to stay valid until the loop
+    // is waited on.
+    template<typename F>
+    Handle Dispatch(size_t count, size_t grain, F&& body) {
+        Handle handle;
+        handle._loop = std::make_unique<Loop>();
+        Loop& loop = *handle._loop;
+        loop.body = std::forward<F>(body);
+        loop.grain = std::max<size_t>(grain, 1);
+        loop.remaining.store(count, std::memory_order_relaxed);
+        if (count > 0) {
+            Push(_queues.size() - 1, { &loop, 0, count });
+        }
+        return handle;
+    }
+
+    // Runs jobs, of this loop or others, until the loop is done.
+    void Wait(Handle& handle) {
+        size_t queue = _queues.size() - 1;
+        while (!handle.done()) {
+            Job job;
+            if (Pop(queue, job) || Steal(queue, job)) {
+                Run(queue, job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        handle._loop.reset();
+    }
+
+    template<typename F>
+    void ParallelFor(size_t count, size_t grain, F&& body) {
+        Handle handle = Dispatch(count, grain, std::forward<F>(body));
+        Wait(handle);
+    }
+
+    // Threads taking part in loops, the waiting one included.
+    inline size_t size() const {
+        return _queues.size();
+    }
+
+    // Counted since the last call.
+    Stats TakeStats() {
+        Stats stats;
+        stats.jobs = _jobs.exchange(0, std::memory_order_relaxed);
+        stats.steals = _steals.exchange(0, std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Job {
+        Loop* loop;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool _stopping;
+    // Jobs in all the queues, workers sleep while it is 0.
+    std::atomic<size_t> _queued;
+    std::atomic<size_t> _next_queue;
+    std::atomic<size_t> _jobs{ 0 };
+    std::atomic<size_t> _steals{ 0 };
+    std::mutex _sleep_mutex;
+    std::condition_variable _condition;
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    void Push(size_t queue, const Job& job) {
+        {
+            std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+            _queues[queue]->jobs.push_back(job);
+        }
+        _queued.fetch_add(1, std::memory_order_release);
+        {
+            // Taken so that a worker about to sleep does not miss the job.
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+        }
+        _condition.notify_one();
+    }
+
+    // Newest job of queue.
+    bool Pop(size_t queue, Job& job) {
+        std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+        auto& jobs = _queues[queue]->jobs;
+        if (jobs.empty()) {
+            return false;
+        }
+        job = jobs.back();
+        jobs.pop_back();
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Oldest job of another queue, starting from a different one each time
+    // so that thieves spread over the victims.
+    bool Steal(size_t thief, Job& job) {
+        size_t start = _next_queue.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < _queues.size(); i++) {
+            size_t victim = (start + i) % _queues.size();
+            if (victim == thief) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(_queues[victim]->mutex);
+            auto& jobs = _queues[victim]->jobs;
+            if (jobs.empty()) {
+                continue;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            _steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Splits job down to the grain, leaving the halves to thieves, and runs
+    // what is left.
+    void Run(size_t queue, Job job) {
+        Loop& loop = *job.loop;
+        while (job.end - job.begin > loop.grain) {
+            size_t middle = job.begin + (job.end - job.begin) / 2;
+            Push(queue, { job.loop, middle, job.end });
+            job.end = middle;
+        }
+        loop.body(job.begin, job.end);
+        _jobs.fetch_add(1, std::memory_order_relaxed);
+        // Last, the loop may be gone as soon as remaining reaches 0.
+        loop.remaining.fetch_sub(job.end - job.begin, std::memory_order_acq_rel);
+    }
+
+    void run(size_t queue) {
+        while (true) {
+            Job job;
+            if (Pop(queue, job) || Steal(queue, job)) {
+                Run(queue, job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            _condition.wait(lock, [this]() {
+                return _stopping || _queued.load(std::memory_order_acquire) > 0;
+            });
+            if (_stopping) {
+                return;
+            }
+        }
+    }
+};
+
+#endif  // __JOB_SYSTEM_H__
@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// Per instance, see instanced_batch.h.
+layout (location = 3) in mat4 aModel;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+}
@@ -1,5 +1,8 @@
+#include <cstdint>
 #include <iostream>
 #include <format>
+#include <memory>
+#include <vector>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
@@ -9,8 +12,13 @@
 #include "gtc/matrix_transform.hpp"
 #include "gtc/type_ptr.hpp"
 
+#include "bounds.h"
+#include "bvh.h"
 #include "camera.h"
+#include "frustum.h"
+#include "instanced_batch.h"
 #include "shader.h"
+#include "shader_watcher.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
@@ -24,6 +32,16 @@ struct Material {
     float shininess;
 };
 
+struct PointLightUniforms {
+    UniformHandle<glm::vec3> position;
+    UniformHandle<float> constant;
+    UniformHandle<float> linear;
+    UniformHandle<float> quadratic;
+    UniformHandle<glm::vec3> ambient;
+    UniformHandle<glm::vec3> diffuse;
+    UniformHandle<glm::vec3> specular;
+};
+
 static Camera camera(
     /* position= */ glm::vec3(0.0f, 0.0f, 3.0f),
     /* up= */ glm::vec3(0.0f, 1.0f, 0.0f)
@@ -242,6 +260,37 @@ int main() {
     glEnableVertexAttribArray(2);
 
 
+    // Every visible cube is an instance, material i is cube_materials[i].
+    constexpr size_t cubes_count = sizeof(cube_positions) / sizeof(glm::vec3);
+    // NR_MATERIALS of shader.fs, a larger index would read past the array.
+    constexpr size_t shader_materials_count = 16;
+    static_assert(cubes_count <= shader_materials_count,
+                  "shader.fs declares fewer materials than there are cubes");
+    static_assert(cubes_count <= sizeof(cube_materials) / sizeof(Material),
+                  "every cube needs its own material");
+    // Owned here so that it is released before the context.
+    auto cubes = std::make_unique<InstancedBatch>(vertex_array, 3);
+    cubes->Reserve(cubes_count);
+
+    // The cubes are static, their model matrices are computed once. Large
+    // sets of moving objects are updated on a JobSystem instead, see
+    // main_transforms_bench.
+    std::vector<glm::mat4> cube_models(cubes_count);
+    for (size_t i = 0; i < cubes_count; i++) {
+        cube_models[i] = glm::translate(glm::mat4(1.0f), cube_positions[i]);
+    }
+
+    // World space bounds of the unit cubes in a BVH, culled against the
+    // view frustum every frame. The batch is only rebuilt when the set of
+    // visible cubes changes.
+    std::vector<BoundingBox> cube_boxes(cubes_count);
+    for (size_t i = 0; i < cubes_count; i++) {
+        cube_boxes[i] = { cube_positions[i] - glm::vec3(0.5f), cube_positions[i] + glm::vec3(0.5f) };
+    }
+    BVH cubes_bvh(cube_boxes);
+    std::vector<uint32_t> cubes_visible;
+    std::vector<uint32_t> cubes_batched;
+
     // Light source.
     unsigned int lightVAO;
     glGenVertexArrays(1, &lightVAO);
@@ -253,17 +302,59 @@ int main() {
         reinterpret_cast<void*>(0 * sizeof(float)));
     glEnableVertexAttribArray(0);
 
-    unsigned int cubeModelLoc = glGetUniformLocation(cube_shader.ID, "model");
-    unsigned int cubeViewLoc = glGetUniformLocation(cube_shader.ID, "view");
-    unsigned int cubeProjectionLoc = glGetUniformLocation(cube_shader.ID, "projection");
+    unsigned int cubeViewLoc;
+    unsigned int cubeProjectionLoc;
+
+    unsigned int lightModelLoc;
+    unsigned int lightViewLoc;
+    unsigned int lightProjectionLoc;
+
+    // Point light uniforms are resolved once, formatting their names every
+    // frame is the most expensive part of the frame on the CPU side.
+    int point_lights_count = sizeof(point_light_positions) / sizeof(glm::vec3);
+    std::vector<PointLightUniforms> point_light_uniforms(point_lights_count);
+    std::vector<UniformHandle<float>> material_shininess(cubes_count);
+
+    // Locations change when a program is rebuilt, so they are resolved again
+    // after every hot reload.
+    auto resolve_uniforms = [&]() {
+        cubeViewLoc = cube_shader.uniformLocation("view");
+        cubeProjectionLoc = cube_shader.uniformLocation("projection");
+
+        lightModelLoc = light_shader.uniformLocation("model");
+        lightViewLoc = light_shader.uniformLocation("view");
+        lightProjectionLoc = light_shader.uniformLocation("projection");
+
+        for (int i = 0; i < point_lights_count; i++) {
+            auto& uniforms = point_light_uniforms[i];
+            uniforms.position = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].position", i));
+            uniforms.constant = cube_shader.uniform<float>(std::format("pointLights[{}].constant", i));
+            uniforms.linear = cube_shader.uniform<float>(std::format("pointLights[{}].linear", i));
+            uniforms.quadratic = cube_shader.uniform<float>(std::format("pointLights[{}].quadratic", i));
+            uniforms.ambient = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].ambient", i));
+            uniforms.diffuse = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].diffuse", i));
+            uniforms.specular = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].specular", i));
+        }
+
+        for (size_t i = 0; i < cubes_count; i++) {
+            material_shininess[i] = cube_shader.uniform<float>(std::format("materialShininess[{}]", i));
+        }
+    };
+    resolve_uniforms();
 
-    unsigned int lightModelLoc = glGetUniformLocation(light_shader.ID, "model");
-    unsigned int lightViewLoc = glGetUniformLocation(light_shader.ID, "view");
-    unsigned int lightProjectionLoc = glGetUniformLocation(light_shader.ID, "projection");
+    // Edits to the .vs/.fs files show up on the next frame.
+    ShaderWatcher shader_watcher;
+    shader_watcher.watch(cube_shader);
+    shader_watcher.watch(light_shader);
 
     float dt = 0.0f;
     float last_frame = 0.0f;
+    float stats_time = 0.0f;
     while (!glfwWindowShouldClose(window)) {
+        if (shader_watcher.applyPendingReloads() > 0) {
+            resolve_uniforms();
+        }
+
         float current_frame = static_cast<float>(glfwGetTime());
         dt = current_frame - last_frame;
         last_frame = current_frame;
@@ -288,20 +379,20 @@ int main() {
         cube_shader.setVec3("spotLight.diffuse", glm::vec3(0.5f));
         cube_shader.setVec3("spotLight.specular", glm::vec3(1.0f));
 
-        int point_lights_count = sizeof(point_light_positions) / sizeof(glm::vec3);
         cube_shader.setInt("point_lights_size", point_lights_count);
         for (size_t i = 0; i < point_lights_count; i++) {
             const auto& light_position = point_light_positions[i];
             const auto& light_diffuse = point_light_diffuse_colors[i];
             const auto& area = point_light_area[i];
-
-            cube_shader.setVec3(std::format("pointLights[{}].position", i), light_position);
-            cube_shader.setFloat(std::format("pointLights[{}].constant", i), area.x);
-            cube_shader.setFloat(std::format("pointLights[{}].linear", i), area.y);
-            cube_shader.setFloat(std::format("pointLights[{}].quadratic", i), area.z);
-            cube_shader.setVec3(std::format("pointLights[{}].ambient", i), glm::vec3(0.0f));
-            cube_shader.setVec3(std::format("pointLights[{}].diffuse", i), light_diffuse);
-            cube_shader.setVec3(std::format("pointLights[{}].specular", i), glm::vec3(0.2f));
+            const auto& uniforms = point_light_uniforms[i];
+
+            cube_shader.set(uniforms.position, light_position);
+            cube_shader.set(uniforms.constant, area.x);
+            cube_shader.set(uniforms.linear, area.y);
+            cube_shader.set(uniforms.quadratic, area.z);
+            cube_shader.set(uniforms.ambient, glm::vec3(0.0f));
+            cube_shader.set(uniforms.diffuse, light_diffuse);
+            cube_shader.set(uniforms.specular, glm::vec3(0.2f));
         }
 
         cube_shader.setVec3("viewPos", camera.position().x, camera.position().y, camera.position().z);
@@ -315,25 +406,33 @@ int main() {
 
         glUniformMatrix4fv(cubeViewLoc, 1, GL_FALSE, glm::value_ptr(camera.view()));
 
-        for (size_t i = 0; i < sizeof(cube_positions) / sizeof(glm::vec3); i++) {
-            const auto& cube_position = cube_positions[i];
-            const auto& cube_material = cube_materials[i];
-
-            cube_shader.setInt("material.diffuse", 0);
-            cube_shader.setInt("material.specular", 1);
-            cube_shader.setFloat("material.shininess", cube_material.shininess);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, containerTexture);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, containerSpecularTexture);
-
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cube_position);
+        cube_shader.setInt("material.diffuse", 0);
+        cube_shader.setInt("material.specular", 1);
+        for (size_t i = 0; i < cubes_count; i++) {
+            cube_shader.set(material_shininess[i], cube_materials[i].shininess);
+        }
 
-            glUniformMatrix4fv(cubeModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, containerTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, containerSpecularTexture);
+
+        cubes_visible.clear();
+        cubes_bvh.Cull(Frustum(projection * camera.view()), cubes_visible);
+        size_t cubes_drawn = cubes_visible.size();
+        if (cubes_visible != cubes_batched) {
+            cubes->Clear();
+            for (uint32_t i: cubes_visible) {
+                cubes->Add(cube_models[i], static_cast<GLint>(i));
+            }
+            cubes_batched = cubes_visible;
+        }
+        cubes->DrawArrays(GL_TRIANGLES, 0, 36);
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        if (current_frame - stats_time >= 1.0f) {
+            std::cout << "Cubes per frame: " << cubes_drawn << " visible, "
+                      << cubes_count - cubes_drawn << " culled" << std::endl;
+            stats_time = current_frame;
         }
 
         // Light.
@@ -361,6 +460,7 @@ int main() {
         glfwPollEvents();
     }
     
+    cubes.reset();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,129 @@
+// Frustum culling benchmark.
+// Scatters from 1k to 1M unit cubes at a constant density, so that about
+// as many of them are in view whatever their number, and measures the CPU
+// time it takes to find the visible ones
+//  - testing every cube against the Camera frustum (Frustum::Cull),
+//  - traversing a BVH built over the cubes,
+// and the time it takes to build the BVH and to refit it after 1% of the
+// cubes moved.
+//
+// The linear test grows with the number of cubes, the BVH traversal with
+// the number of visible ones and the depth of the tree.
+//
+// Usage: ./main_culling_bench
+// Runs on the CPU only, no window or GL context is created.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+
+#include "bounds.h"
+#include "bvh.h"
+#include "camera.h"
+#include "frustum.h"
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+namespace {
+
+constexpr int kWarmupRuns = 3;
+constexpr int kRuns = 20;
+constexpr size_t kCubeCounts[] = { 1000, 10000, 100000, 1000000 };
+// Cubes per unit of volume.
+constexpr float kDensity = 0.001f;
+// Share of the cubes moved between two refits.
+constexpr size_t kMovedEvery = 100;
+
+// Runs body kRuns times and returns the average time it took, in
+// milliseconds.
+template<typename F>
+double MeasureMs(F&& body) {
+    for (int i = 0; i < kWarmupRuns; i++) {
+        body();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRuns; i++) {
+        body();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / kRuns;
+}
+
+BoundingBox CubeAt(const glm::vec3& position) {
+    return { position - glm::vec3(0.5f), position + glm::vec3(0.5f) };
+}
+
+}  // namespace
+
+int main() {
+    // Looks down -Z from the center of every scene.
+    Camera camera(
+        /* position= */ glm::vec3(0.0f, 0.0f, 0.0f),
+        /* up= */ glm::vec3(0.0f, 1.0f, 0.0f)
+    );
+    glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()),
+        static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
+    Frustum frustum(projection * camera.view());
+
+    std::mt19937 random(42);
+    for (size_t count: kCubeCounts) {
+        float side = std::cbrt(count / kDensity);
+        std::uniform_real_distribution<float> coordinate(-side * 0.5f, side * 0.5f);
+
+        std::vector<BoundingBox> boxes(count);
+        std::vector<BoundingSphere> spheres(count);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 position(coordinate(random), coordinate(random), coordinate(random));
+            boxes[i] = CubeAt(position);
+            spheres[i] = { position, std::sqrt(3.0f) * 0.5f };
+        }
+
+        std::vector<uint8_t> visible(count);
+        size_t linear_visible = 0;
+        double linear_ms = MeasureMs([&]() {
+            linear_visible = frustum.Cull(boxes.data(), spheres.data(), count, visible.data());
+        });
+
+        BVH bvh;
+        double build_ms = MeasureMs([&]() {
+            bvh.Build(boxes);
+        });
+
+        std::vector<uint32_t> bvh_visible;
+        bvh_visible.reserve(count);
+        double bvh_ms = MeasureMs([&]() {
+            bvh_visible.clear();
+            bvh.Cull(frustum, bvh_visible);
+        });
+        BVH::Stats stats = bvh.stats();
+
+        // Moves every kMovedEvery-th cube by up to a unit.
+        std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+        double refit_ms = MeasureMs([&]() {
+            for (size_t i = 0; i < count; i += kMovedEvery) {
+                glm::vec3 offset(step(random), step(random), step(random));
+                boxes[i] = { boxes[i].min + offset, boxes[i].max + offset };
+                bvh.Update(static_cast<uint32_t>(i), boxes[i]);
+            }
+        });
+
+        std::cout << count << " cubes, " << linear_visible << " visible" << std::endl;
+        std::cout << "  Linear: " << linear_ms << " ms" << std::endl;
+        std::cout << "  BVH:    " << bvh_ms << " ms, " << bvh_visible.size() << " visible, "
+                  << stats.nodes_tested << " of " << bvh.nodes() << " nodes tested, "
+                  << stats.nodes_inside << " inside" << std::endl;
+        std::cout << "  BVH build: " << build_ms << " ms, refit of "
+                  << (count + kMovedEvery - 1) / kMovedEvery << " cubes: " << refit_ms
+                  << " ms" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Instancing benchmark.
+// Draws from 10 to 100k small cubes and measures the CPU time spent to
+// submit a frame when they are drawn
+//  - one by one, a model matrix uniform and a glDrawArrays per cube,
+//  - with an InstancedBatch built once (a single glDrawArraysInstanced),
+//  - with an InstancedBatch rebuilt and uploaded every frame, as moving
+//    objects would be.
+//
+// Usage: ./main_instancing_bench
+// Runs in an invisible window, so it works under headless Mesa as well:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe xvfb-run ./main_instancing_bench
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+#include "gtc/type_ptr.hpp"
+
+#include "instanced_batch.h"
+#include "shader.h"
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+namespace {
+
+constexpr int kWarmupFrames = 10;
+constexpr int kFrames = 100;
+constexpr size_t kInstanceCounts[] = { 10, 100, 1000, 10000, 100000 };
+
+// Runs the frame body kFrames times and returns the average CPU time it
+// took to submit a frame, in milliseconds. glFinish between frames keeps
+// the driver queue from growing, and is not part of the measurement.
+template<typename F>
+double MeasureFrameMs(F&& frame) {
+    for (int i = 0; i < kWarmupFrames; i++) {
+        frame();
+        glFinish();
+    }
+
+    double total_ms = 0.0;
+    for (int i = 0; i < kFrames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        frame();
+        auto end = std::chrono::steady_clock::now();
+        total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        glFinish();
+    }
+    return total_ms / kFrames;
+}
+
+// Cubes on a grid around the origin, small enough not to overlap.
+std::vector<glm::mat4> GridModels(size_t count) {
+    size_t side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+    std::vector<glm::mat4> models;
+    models.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 cell(i % side, (i / side) % side, i / (side * side));
+        glm::vec3 position = (cell - glm::vec3(side * 0.5f)) * (4.0f / side);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        models.push_back(glm::scale(model, glm::vec3(2.0f / side)));
+    }
+    return models;
+}
+
+}  // namespace
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+    if (!window) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "Failed to initialised GLAD" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    float vertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f,  0.5f, -0.5f,
+         0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f, -0.5f,  0.5f,
+        -0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f, -0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f, -0.5f,
+         0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f,
+        -0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f,
+    };
+
+    Shader shader("lighting.vs", "lighting.fs");
+    Shader instanced_shader("lighting_instanced.vs", "lighting.fs");
+
+    unsigned int vertex_array;
+    glGenVertexArrays(1, &vertex_array);
+    glBindVertexArray(vertex_array);
+
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+
+    // Same vertices, the batch adds its instance attributes to this one.
+    unsigned int instanced_vertex_array;
+    glGenVertexArrays(1, &instanced_vertex_array);
+    glBindVertexArray(instanced_vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 8.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+        static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
+    for (Shader* program: { &shader, &instanced_shader }) {
+        program->use();
+        program->setMat4("view", view);
+        program->setMat4("projection", projection);
+        program->setVec3("diffuseColour", glm::vec3(0.8f, 0.6f, 0.2f));
+    }
+
+    auto batch = std::make_unique<InstancedBatch>(instanced_vertex_array, 3);
+    UniformHandle<glm::mat4> model_uniform = shader.uniform<glm::mat4>("model");
+
+    std::cout << "Instances  Per cube (ms)  Instanced (ms)  Rebuilt (ms)" << std::endl;
+    for (size_t count: kInstanceCounts) {
+        std::vector<glm::mat4> models = GridModels(count);
+
+        shader.use();
+        glBindVertexArray(vertex_array);
+        double per_cube_ms = MeasureFrameMs([&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (const auto& model: models) {
+                shader.set(model_uniform, model);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        });
+
+        instanced_shader.use();
+        batch->Clear();
+        batch->Reserve(count);
+        for (const auto& model: models) {
+            batch->Add(model);
+        }
+        double instanced_ms = MeasureFrameMs([&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            batch->DrawArrays(GL_TRIANGLES, 0, 36);
+        });
+
+        double rebuilt_ms = MeasureFrameMs([&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            batch->Clear();
+            for (const auto& model: models) {
+                batch->Add(model);
+            }
+            batch->DrawArrays(GL_TRIANGLES, 0, 36);
+        });
+
+        std::cout << count << "  " << per_cube_ms << "  " << instanced_ms
+                  << "  " << rebuilt_ms << std::endl;
+    }
+
+    batch.reset();
+    glDeleteVertexArrays(1, &vertex_array);
+    glDeleteVertexArrays(1, &instanced_vertex_array);
+    glDeleteBuffers(1, &buffer);
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,296 @@
+// Frame CPU time benchmark for the multiple lights scene.
+// Renders the ten cubes lit by up to 256 point lights and measures the CPU
+// time spent to submit a frame when point light uniforms are
+//  - looked up by std::format-ed names every frame,
+//  - uploaded through UniformHandle<T> resolved once before the loop.
+//
+// The scene's shader.fs is loaded with NR_POINT_LIGHTS raised, as far as
+// GL_MAX_FRAGMENT_UNIFORM_COMPONENTS allows (4096 on macOS fit about 130
+// lights).
+//
+// Usage: ./main_lights_bench [point lights, default as many as fit]
+// Runs in an invisible window, so it works under headless Mesa as well:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe xvfb-run ./main_lights_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+#include "gtc/type_ptr.hpp"
+
+#include "instanced_batch.h"
+#include "shader.h"
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+namespace {
+
+constexpr int kMaxPointLights = 256;
+// When the limit cannot be queried.
+constexpr int kDefaultPointLights = 128;
+// Fragment uniform components a PointLight takes once its members are
+// padded to vec4, and those left for the rest of shader.fs (materials,
+// directional and spot lights).
+constexpr int kPointLightComponents = 28;
+constexpr int kReservedComponents = 256;
+constexpr int kWarmupFrames = 20;
+constexpr int kFrames = 300;
+
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 area;
+    glm::vec3 diffuse;
+};
+
+struct PointLightUniforms {
+    UniformHandle<glm::vec3> position;
+    UniformHandle<float> constant;
+    UniformHandle<float> linear;
+    UniformHandle<float> quadratic;
+    UniformHandle<glm::vec3> ambient;
+    UniformHandle<glm::vec3> diffuse;
+    UniformHandle<glm::vec3> specular;
+};
+
+const glm::vec3 kCubePositions[] = {
+    glm::vec3(0.0f, 0.0f, 0.0f),
+    glm::vec3( 2.0f, 5.0f, -15.0f),
+    glm::vec3(-1.5f, -2.2f, -2.5f),
+    glm::vec3(-3.8f, -2.0f, -12.3f),
+    glm::vec3( 2.4f, -0.4f, -3.5f),
+    glm::vec3(-1.7f, 3.0f, -7.5f),
+    glm::vec3( 1.3f, -2.0f, -2.5f),
+    glm::vec3( 1.5f, 2.0f, -2.5f),
+    glm::vec3( 1.5f, 0.2f, -1.5f),
+    glm::vec3(-1.3f, 1.0f, -1.5f),
+};
+
+// Runs the frame body kFrames times and returns the average CPU time it
+// took to submit a frame, in milliseconds. glFinish between frames keeps
+// the driver queue from growing, and is not part of the measurement.
+template<typename F>
+double MeasureFrameMs(F&& frame) {
+    for (int i = 0; i < kWarmupFrames; i++) {
+        frame();
+        glFinish();
+    }
+
+    double total_ms = 0.0;
+    for (int i = 0; i < kFrames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        frame();
+        auto end = std::chrono::steady_clock::now();
+        total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        glFinish();
+    }
+    return total_ms / kFrames;
+}
+
+// Point lights shader.fs can declare without going over the fragment
+// uniform limit of the driver.
+int MaxPointLights() {
+    int components = 0;
+    glGetIntegerv(GL_MAX_FRAGMENT_UNIFORM_COMPONENTS, &components);
+    if (components <= kReservedComponents) {
+        return kDefaultPointLights;
+    }
+    return std::min(kMaxPointLights,
+        (components - kReservedComponents) / kPointLightComponents);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+    if (!window) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "Failed to initialised GLAD" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    const int max_point_lights = MaxPointLights();
+    int point_lights_count = max_point_lights;
+    if (argc > 1) {
+        point_lights_count = std::atoi(argv[1]);
+    }
+    if (point_lights_count < 0 || point_lights_count > max_point_lights) {
+        std::cout << "Point lights count should be in [0, " << max_point_lights << "]" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    float vertices[] = {
+        // positions // normals // texture coords
+        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+        0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
+        -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+        -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, 0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        -0.5f, -0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+        -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+        0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
+        0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,
+        0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
+        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+        0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+        -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    };
+
+    std::vector<PointLight> point_lights(point_lights_count);
+    for (int i = 0; i < point_lights_count; i++) {
+        float angle = glm::radians(360.0f * i / max_point_lights);
+        point_lights[i].position = glm::vec3(8.0f * std::cos(angle), 0.0f, 8.0f * std::sin(angle) - 5.0f);
+        point_lights[i].area = glm::vec3(1.0f, 0.045f, 0.075f);
+        point_lights[i].diffuse = glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+
+    // The scene's shader, with room for every light.
+    Shader cube_shader("shader.vs", "shader.fs",
+        { { "NR_POINT_LIGHTS", std::to_string(max_point_lights) } });
+
+    unsigned int vertex_array;
+    glGenVertexArrays(1, &vertex_array);
+    glBindVertexArray(vertex_array);
+
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+        reinterpret_cast<void*>(0 * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+        reinterpret_cast<void*>(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+        reinterpret_cast<void*>(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    auto cubes = std::make_unique<InstancedBatch>(vertex_array, 3);
+    for (const auto& cube_position: kCubePositions) {
+        cubes->Add(glm::translate(glm::mat4(1.0f), cube_position));
+    }
+
+    cube_shader.use();
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+        static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
+
+    auto draw_cubes = [&]() {
+        cube_shader.setMat4("view", view);
+        cube_shader.setMat4("projection", projection);
+        cube_shader.setInt("point_lights_size", point_lights_count);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        cubes->DrawArrays(GL_TRIANGLES, 0, 36);
+    };
+
+    double formatted_ms = MeasureFrameMs([&]() {
+        for (int i = 0; i < point_lights_count; i++) {
+            const auto& light = point_lights[i];
+            cube_shader.setVec3(std::format("pointLights[{}].position", i), light.position);
+            cube_shader.setFloat(std::format("pointLights[{}].constant", i), light.area.x);
+            cube_shader.setFloat(std::format("pointLights[{}].linear", i), light.area.y);
+            cube_shader.setFloat(std::format("pointLights[{}].quadratic", i), light.area.z);
+            cube_shader.setVec3(std::format("pointLights[{}].ambient", i), glm::vec3(0.0f));
+            cube_shader.setVec3(std::format("pointLights[{}].diffuse", i), light.diffuse);
+            cube_shader.setVec3(std::format("pointLights[{}].specular", i), glm::vec3(0.2f));
+        }
+        draw_cubes();
+    });
+
+    std::vector<PointLightUniforms> point_light_uniforms(point_lights_count);
+    for (int i = 0; i < point_lights_count; i++) {
+        auto& uniforms = point_light_uniforms[i];
+        uniforms.position = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].position", i));
+        uniforms.constant = cube_shader.uniform<float>(std::format("pointLights[{}].constant", i));
+        uniforms.linear = cube_shader.uniform<float>(std::format("pointLights[{}].linear", i));
+        uniforms.quadratic = cube_shader.uniform<float>(std::format("pointLights[{}].quadratic", i));
+        uniforms.ambient = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].ambient", i));
+        uniforms.diffuse = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].diffuse", i));
+        uniforms.specular = cube_shader.uniform<glm::vec3>(std::format("pointLights[{}].specular", i));
+    }
+
+    double handles_ms = MeasureFrameMs([&]() {
+        for (int i = 0; i < point_lights_count; i++) {
+            const auto& light = point_lights[i];
+            const auto& uniforms = point_light_uniforms[i];
+            cube_shader.set(uniforms.position, light.position);
+            cube_shader.set(uniforms.constant, light.area.x);
+            cube_shader.set(uniforms.linear, light.area.y);
+            cube_shader.set(uniforms.quadratic, light.area.z);
+            cube_shader.set(uniforms.ambient, glm::vec3(0.0f));
+            cube_shader.set(uniforms.diffuse, light.diffuse);
+            cube_shader.set(uniforms.specular, glm::vec3(0.2f));
+        }
+        draw_cubes();
+    });
+
+    std::cout << "Point lights: " << point_lights_count << std::endl;
+    std::cout << "Formatted names: " << formatted_ms << " ms/frame" << std::endl;
+    std::cout << "Typed handles:   " << handles_ms << " ms/frame" << std::endl;
+
+    cubes.reset();
+    glDeleteVertexArrays(1, &vertex_array);
+    glDeleteBuffers(1, &buffer);
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Matrix batch benchmark.
+// Computes the model-view-projection and normal matrices of 1M random
+// model matrices and measures the time it takes
+//  - one matrix at a time with GLM, as the shaders did per vertex
+//    (projection * view * model, transpose(inverse(mat3(model)))),
+//  - with the batch kernels of matrix_batch.h (MultiplyMatrices,
+//    NormalMatrices), on whichever of AVX, SSE or scalar code the build
+//    enables,
+// and the largest difference between the two results.
+//
+// Usage: ./main_matrix_bench
+// Runs on the CPU only, no window or GL context is created.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+
+#include "matrix_batch.h"
+
+namespace {
+
+constexpr int kWarmupRuns = 3;
+constexpr int kRuns = 20;
+constexpr size_t kMatrices = 1000000;
+
+// Runs body kRuns times and returns the average time it took, in
+// milliseconds.
+template<typename F>
+double MeasureMs(F&& body) {
+    for (int i = 0; i < kWarmupRuns; i++) {
+        body();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRuns; i++) {
+        body();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / kRuns;
+}
+
+const char* KernelName() {
+#if defined(MATRIX_BATCH_AVX)
+    return "AVX";
+#elif defined(MATRIX_BATCH_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    std::vector<glm::mat4> models(kMatrices);
+    for (auto& model: models) {
+        model = glm::translate(glm::mat4(1.0f),
+            glm::vec3(coordinate(random), coordinate(random), coordinate(random)));
+        model = glm::rotate(model, glm::radians(angle(random)),
+            glm::normalize(glm::vec3(coordinate(random), coordinate(random), 1.0f)));
+        model = glm::scale(model, glm::vec3(scale(random), scale(random), scale(random)));
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 8.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view_projection = projection * view;
+
+    std::vector<glm::mat4> glm_mvps(kMatrices);
+    std::vector<glm::mat3> glm_normals(kMatrices);
+    double glm_ms = MeasureMs([&]() {
+        for (size_t i = 0; i < kMatrices; i++) {
+            glm_mvps[i] = view_projection * models[i];
+            glm_normals[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+        }
+    });
+
+    std::vector<glm::mat4> mvps(kMatrices);
+    std::vector<NormalMatrix> normals(kMatrices);
+    double mvp_ms = MeasureMs([&]() {
+        MultiplyMatrices(view_projection, models.data(), kMatrices, mvps.data());
+    });
+    double normal_ms = MeasureMs([&]() {
+        NormalMatrices(models.data(), kMatrices, normals.data());
+    });
+
+    float mvp_error = 0.0f;
+    float normal_error = 0.0f;
+    for (size_t i = 0; i < kMatrices; i++) {
+        glm::mat3 normal = ToMat3(normals[i]);
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                mvp_error = std::max(mvp_error, std::fabs(mvps[i][c][r] - glm_mvps[i][c][r]));
+                if (c < 3 && r < 3) {
+                    normal_error = std::max(normal_error,
+                        std::fabs(normal[c][r] - glm_normals[i][c][r]));
+                }
+            }
+        }
+    }
+
+    std::cout << kMatrices << " matrices" << std::endl;
+    std::cout << "  GLM, one at a time: " << glm_ms << " ms" << std::endl;
+    std::cout << "  " << KernelName() << " batch: " << mvp_ms + normal_ms << " ms ("
+              << mvp_ms << " ms MVP, " << normal_ms << " ms normal), "
+              << glm_ms / (mvp_ms + normal_ms) << "x" << std::endl;
+    std::cout << "  Largest difference: " << mvp_error << " MVP, " << normal_error
+              << " normal" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Uniform setters microbenchmark.
+// Compares the cost of pushing the point light uniforms of this lesson:
+//  - by name, asking the driver for the location on every call (the way
+//    Shader used to work),
+//  - by name, through the location table Shader builds after link,
+//  - by location, resolved once up front.
+//
+// Runs in an invisible window, so it works under headless Mesa as well:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe xvfb-run ./main_uniforms_bench
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+#include "gtc/type_ptr.hpp"
+
+#include "shader.h"
+
+namespace {
+
+constexpr int kIterations = 100000;
+constexpr int kPointLights = 4;
+
+const char* kFields[] = {
+    "position",
+    "constant",
+    "linear",
+    "quadratic",
+    "ambient",
+    "diffuse",
+    "specular",
+};
+constexpr int kFieldsCount = sizeof(kFields) / sizeof(kFields[0]);
+
+template<typename F>
+double MeasureNsPerCall(F&& body) {
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        body();
+    }
+    glFinish();
+    auto end = std::chrono::steady_clock::now();
+
+    double total_ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return total_ns / (static_cast<double>(kIterations) * kPointLights * kFieldsCount);
+}
+
+}  // namespace
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "LearnOpenGL", nullptr, nullptr);
+    if (!window) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "Failed to initialised GLAD" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    Shader shader("shader.vs", "shader.fs");
+    shader.use();
+
+    std::vector<std::string> names;
+    std::vector<int> locations;
+    for (int i = 0; i < kPointLights; i++) {
+        for (int j = 0; j < kFieldsCount; j++) {
+            names.push_back(std::format("pointLights[{}].{}", i, kFields[j]));
+            locations.push_back(shader.uniformLocation(names.back()));
+        }
+    }
+
+    float value = 0.0f;
+
+    double driver_lookup = MeasureNsPerCall([&]() {
+        for (const auto& name: names) {
+            glUniform1f(glGetUniformLocation(shader.ID, name.c_str()), value);
+        }
+        value += 1.0f;
+    });
+
+    double table_lookup = MeasureNsPerCall([&]() {
+        for (const auto& name: names) {
+            shader.setFloat(name, value);
+        }
+        value += 1.0f;
+    });
+
+    double location = MeasureNsPerCall([&]() {
+        for (int loc: locations) {
+            shader.setFloat(loc, value);
+        }
+        value += 1.0f;
+    });
+
+    std::cout << "glGetUniformLocation per call: " << driver_lookup << " ns/uniform" << std::endl;
+    std::cout << "Shader location table:         " << table_lookup << " ns/uniform" << std::endl;
+    std::cout << "Cached location:               " << location << " ns/uniform" << std::endl;
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,196 @@
+#ifndef __MATRIX_BATCH_H__
+#define __MATRIX_BATCH_H__
+
+#include <cstddef>
+
+#include "glm.hpp"
+
+#if defined(__AVX__)
+#define MATRIX_BATCH_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_BATCH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Matrix math over arrays of objects, so that the CPU builds what the
+// shaders would otherwise recompute per vertex: model-view-projection
+// matrices and normal matrices (the inverse transpose of the upper 3x3 of
+// a model or model-view matrix, transpose(inverse(mat3(model))) in GLSL).
+//
+// Matrices are loaded and stored unaligned, a column at a time. With AVX
+// two columns (or two normal matrices) are handled per instruction, with
+// SSE one, otherwise the loops are scalar.
+
+// A mat3 whose columns are padded to vec4, as std140 lays it out and as
+// the SIMD kernels store it. Read as a mat3 vertex attribute with a stride
+// of sizeof(NormalMatrix), or converted with ToMat3 for a uniform.
+struct NormalMatrix {
+    glm::vec4 columns[3];
+};
+
+inline glm::mat3 ToMat3(const NormalMatrix& normal) {
+    return glm::mat3(glm::vec3(normal.columns[0]), glm::vec3(normal.columns[1]),
+                     glm::vec3(normal.columns[2]));
+}
+
+namespace matrix_batch {
+
+#ifdef MATRIX_BATCH_SSE
+// (a.y, a.z, a.x, a.w) and (a.z, a.x, a.y, a.w).
+inline __m128 YZX(__m128 a) {
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+inline __m128 ZXY(__m128 a) {
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+}
+
+// w is a.w * b.w - a.w * b.w: 0, or close to it once the compiler fuses
+// the multiply and subtract. Nothing reads it.
+inline __m128 Cross(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(YZX(a), ZXY(b)), _mm_mul_ps(ZXY(a), YZX(b)));
+}
+#endif
+
+#ifdef MATRIX_BATCH_AVX
+// As above, on two vectors per register.
+inline __m256 YZX(__m256 a) {
+    return _mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+inline __m256 ZXY(__m256 a) {
+    return _mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+}
+
+inline __m256 Cross(__m256 a, __m256 b) {
+    return _mm256_sub_ps(_mm256_mul_ps(YZX(a), ZXY(b)), _mm256_mul_ps(ZXY(a), YZX(b)));
+}
+
+inline __m256 MultiplyAdd(__m256 a, __m256 b, __m256 c) {
+#ifdef __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// Column column of the matrices at first and second, in the low and high
+// halves.
+inline __m256 LoadColumns(const glm::mat4& first, const glm::mat4& second, int column) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&first[column][0])),
+                                _mm_loadu_ps(&second[column][0]), 1);
+}
+#endif
+
+}  // namespace matrix_batch
+
+// out[i] = left * right[i], e.g. model = parent * local or
+// mvp = projection * view * model. out may alias right: a column of
+// out[i] only depends on the same column of right[i].
+inline void MultiplyMatrices(const glm::mat4& left, const glm::mat4* right, size_t count,
+                             glm::mat4* out) {
+#if defined(MATRIX_BATCH_AVX)
+    // Both halves hold the same column of left, each half of a load two
+    // consecutive columns of right[i].
+    __m256 l[4];
+    for (int k = 0; k < 4; k++) {
+        l[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&left[k][0]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 4; c += 2) {
+            __m256 r = _mm256_loadu_ps(&right[i][c][0]);
+            __m256 result = _mm256_mul_ps(l[0], _mm256_permute_ps(r, 0x00));
+            result = matrix_batch::MultiplyAdd(l[1], _mm256_permute_ps(r, 0x55), result);
+            result = matrix_batch::MultiplyAdd(l[2], _mm256_permute_ps(r, 0xAA), result);
+            result = matrix_batch::MultiplyAdd(l[3], _mm256_permute_ps(r, 0xFF), result);
+            _mm256_storeu_ps(&out[i][c][0], result);
+        }
+    }
+#elif defined(MATRIX_BATCH_SSE)
+    __m128 l[4];
+    for (int k = 0; k < 4; k++) {
+        l[k] = _mm_loadu_ps(&left[k][0]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 4; c++) {
+            __m128 r = _mm_loadu_ps(&right[i][c][0]);
+            __m128 result = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(l[0], _mm_shuffle_ps(r, r, 0x00)),
+                           _mm_mul_ps(l[1], _mm_shuffle_ps(r, r, 0x55))),
+                _mm_add_ps(_mm_mul_ps(l[2], _mm_shuffle_ps(r, r, 0xAA)),
+                           _mm_mul_ps(l[3], _mm_shuffle_ps(r, r, 0xFF))));
+            _mm_storeu_ps(&out[i][c][0], result);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        out[i] = left * right[i];
+    }
+#endif
+}
+
+// Normal matrices of models, through cofactors: the inverse transpose of
+// a 3x3 matrix with columns c0, c1, c2 has the columns cross(c1, c2),
+// cross(c2, c0) and cross(c0, c1) over its determinant. Models have to be
+// invertible.
+inline void NormalMatrices(const glm::mat4* models, size_t count, NormalMatrix* out) {
+    size_t i = 0;
+#if defined(MATRIX_BATCH_AVX)
+    for (; i + 2 <= count; i += 2) {
+        __m256 c0 = matrix_batch::LoadColumns(models[i], models[i + 1], 0);
+        __m256 c1 = matrix_batch::LoadColumns(models[i], models[i + 1], 1);
+        __m256 c2 = matrix_batch::LoadColumns(models[i], models[i + 1], 2);
+        __m256 n0 = matrix_batch::Cross(c1, c2);
+        __m256 n1 = matrix_batch::Cross(c2, c0);
+        __m256 n2 = matrix_batch::Cross(c0, c1);
+
+        // dot(c0, n0) in every lane of each half, n0.w is 0.
+        __m256 det = _mm256_mul_ps(c0, n0);
+        det = _mm256_add_ps(det, _mm256_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+        det = _mm256_add_ps(det, _mm256_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+        __m256 inverse_det = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+        const __m256 columns[3] = { _mm256_mul_ps(n0, inverse_det),
+                                    _mm256_mul_ps(n1, inverse_det),
+                                    _mm256_mul_ps(n2, inverse_det) };
+        for (int c = 0; c < 3; c++) {
+            _mm_storeu_ps(&out[i].columns[c][0], _mm256_castps256_ps128(columns[c]));
+            _mm_storeu_ps(&out[i + 1].columns[c][0], _mm256_extractf128_ps(columns[c], 1));
+        }
+    }
+#endif
+#if defined(MATRIX_BATCH_SSE)
+    for (; i < count; i++) {
+        __m128 c0 = _mm_loadu_ps(&models[i][0][0]);
+        __m128 c1 = _mm_loadu_ps(&models[i][1][0]);
+        __m128 c2 = _mm_loadu_ps(&models[i][2][0]);
+        __m128 n0 = matrix_batch::Cross(c1, c2);
+        __m128 n1 = matrix_batch::Cross(c2, c0);
+        __m128 n2 = matrix_batch::Cross(c0, c1);
+
+        __m128 det = _mm_mul_ps(c0, n0);
+        det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+        det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+        __m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        _mm_storeu_ps(&out[i].columns[0][0], _mm_mul_ps(n0, inverse_det));
+        _mm_storeu_ps(&out[i].columns[1][0], _mm_mul_ps(n1, inverse_det));
+        _mm_storeu_ps(&out[i].columns[2][0], _mm_mul_ps(n2, inverse_det));
+    }
+#else
+    for (; i < count; i++) {
+        const glm::vec3 c0(models[i][0]);
+        const glm::vec3 c1(models[i][1]);
+        const glm::vec3 c2(models[i][2]);
+        const glm::vec3 n0 = glm::cross(c1, c2);
+        const float inverse_det = 1.0f / glm::dot(c0, n0);
+        out[i].columns[0] = glm::vec4(n0 * inverse_det, 0.0f);
+        out[i].columns[1] = glm::vec4(glm::cross(c2, c0) * inverse_det, 0.0f);
+        out[i].columns[2] = glm::vec4(glm::cross(c0, c1) * inverse_det, 0.0f);
+    }
+#endif
+}
+
+#endif  // __MATRIX_BATCH_H__
@@ -2,7 +2,6 @@
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
-    float shininess;
 };
 
 struct DirectionalLight {
@@ -37,15 +36,24 @@ struct SpotLight {
     float outerCutOff;
 };
 
+// Both may be raised at load time, see Shader::Defines.
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 4
+#endif
+#ifndef NR_MATERIALS
+#define NR_MATERIALS 16  // shader_materials_count in main.cpp
+#endif
 
 out vec4 FragColor;
 
 in vec3 fNorm;
 in vec3 fPos;
 in vec2 TexCoords;
+flat in int fMaterial;
 
 uniform Material material;
+// Shininess of every material an instance may use.
+uniform float materialShininess[NR_MATERIALS];
 uniform DirectionalLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform int point_lights_size;
@@ -63,7 +71,7 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
 
     vec3 reflectDir = reflect(-lightDir, normal);
 
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialShininess[fMaterial]);
     vec3 specular = light.specular * (spec * vec3(texture(material.specular, TexCoords)));
 
     return (ambient + diffuse + specular);
@@ -83,7 +91,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 
     vec3 reflectDir = reflect(-lightDir, norm);
 
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialShininess[fMaterial]);
     vec3 specular = light.specular * (spec * vec3(texture(material.specular, TexCoords)));
 
     ambient *= attenuation;
@@ -103,7 +111,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 
     vec3 reflectDir = reflect(-lightDir, normal);
 
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialShininess[fMaterial]);
     vec3 specular = light.specular * (spec * vec3(texture(material.specular, TexCoords)));
 
     float theta = dot(normalize(-light.direction), lightDir);
@@ -2,108 +2,537 @@
 #define __SHADER_H__
 
 #include <string>
+#include <vector>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include <glad.h>
 
+#include "program_binary_cache.h"
+#include "uniform_buffer.h"
+
+// Describes how a C++ type maps onto GLSL uniforms: which GL types it may be
+// bound to and how to upload it.
+template<typename T>
+struct UniformTraits;
+
+template<>
+struct UniformTraits<bool> {
+    static bool accepts(GLenum type) {
+        return type == GL_BOOL;
+    }
+
+    static void upload(int location, bool value) {
+        glUniform1i(location, static_cast<int>(value));
+    }
+};
+
+template<>
+struct UniformTraits<int> {
+    static bool accepts(GLenum type) {
+        switch (type) {
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_ARRAY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static void upload(int location, int value) {
+        glUniform1i(location, value);
+    }
+};
+
+template<>
+struct UniformTraits<float> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT;
+    }
+
+    static void upload(int location, float value) {
+        glUniform1f(location, value);
+    }
+};
+
+template<>
+struct UniformTraits<glm::vec3> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT_VEC3;
+    }
+
+    static void upload(int location, const glm::vec3& value) {
+        glUniform3f(location, value.x, value.y, value.z);
+    }
+};
+
+template<>
+struct UniformTraits<glm::mat4> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT_MAT4;
+    }
+
+    static void upload(int location, const glm::mat4& value) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+};
+
+// A uniform location tagged with its C++ type. Resolve it once through
+// Shader::uniform<T>() and keep it, then upload with Shader::set().
+template<typename T>
+class UniformHandle {
+public:
+    UniformHandle() noexcept : _location(-1) {}
+
+    explicit UniformHandle(int location) noexcept : _location(location) {}
+
+    inline int location() const {
+        return _location;
+    }
+
+    inline bool valid() const {
+        return _location >= 0;
+    }
+
+private:
+    int _location;
+};
+
 class Shader {
 public:
     unsigned int ID;
 
+    // Tag for the constructor that only submits the program to the driver.
+    struct Deferred {};
+
+    // Macros defined in both stages right after #version, e.g.
+    // { "NR_POINT_LIGHTS", "128" }, so that one source serves several
+    // variants. Sources keep their defaults behind #ifndef.
+    using Defines = std::vector<std::pair<std::string, std::string>>;
+
+    Shader(const char* vertex_shader_path,
+           const char* fragment_shader_path,
+           const Defines& defines = Defines()) :
+           Shader(vertex_shader_path, fragment_shader_path, Deferred(), defines) {
+        finish();
+    }
+
+    // Starts compiling and linking without waiting for the driver: no
+    // status is queried until finish(), so several programs (and asset
+    // loading) can overlap with the compilation. See ShaderLibrary.
     Shader(const char* vertex_shader_path,
-           const char* fragment_shader_path) {
+           const char* fragment_shader_path,
+           Deferred,
+           const Defines& defines = Defines()) :
+           ID(0),
+           _loaded_from_cache(false),
+           _finished(false),
+           _load_time_ms(0.0),
+           _vertex_shader(0),
+           _fragment_shader(0),
+           _vertex_path(vertex_shader_path),
+           _fragment_path(fragment_shader_path),
+           _defines(defines),
+           _submit_time(std::chrono::steady_clock::now()) {
         std::string vertex_code;
         std::string fragment_code;
-
-        std::ifstream v_shader_file;
-        v_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        std::ifstream f_shader_file;
-        f_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-        try {
-            v_shader_file.open(vertex_shader_path);
-            f_shader_file.open(fragment_shader_path);
-            std::stringstream v_shader_stream;
-            std::stringstream f_shader_stream;
-            v_shader_stream << v_shader_file.rdbuf();
-            f_shader_stream << f_shader_file.rdbuf();
-            v_shader_file.close();
-            f_shader_file.close();
-            vertex_code = v_shader_stream.str();
-            fragment_code = f_shader_stream.str();
-        } catch (std::ifstream::failure e) {
-            std::cout << "Failed to load a file." << std::endl;
+        if (!readSources(vertex_code, fragment_code)) {
             std::abort();
         }
 
-        const char* vc_ptr = vertex_code.c_str();
-        const char* fc_ptr = fragment_code.c_str();
+        _cache_key = ProgramBinaryCache::Key(vertex_code, fragment_code);
 
-        unsigned int vid;
-        unsigned int fid;
+        ID = glCreateProgram();
+        _loaded_from_cache = ProgramBinaryCache::Load(ID, _cache_key);
+        if (!_loaded_from_cache) {
+            // A rejected binary may leave state behind, start from a fresh program.
+            glDeleteProgram(ID);
+            ID = glCreateProgram();
+            submitCompileAndLink(vertex_code, fragment_code);
+        }
+    }
 
-        int status;
-        char infoLog[512];
+    // Non blocking check whether the driver is done with the program, only
+    // meaningful with KHR_parallel_shader_compile (otherwise any status
+    // query blocks anyway). The extension has to be exposed by the driver,
+    // not just known to glad: GL_COMPLETION_STATUS_KHR is an invalid enum
+    // otherwise.
+    bool isReady() const {
+        if (_finished || _loaded_from_cache) {
+            return true;
+        }
+#ifdef GL_KHR_parallel_shader_compile
+        if (!GLAD_GL_KHR_parallel_shader_compile) {
+            return true;
+        }
+        int completed = GL_TRUE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed;
+#else
+        return true;
+#endif
+    }
 
-        vid = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vid, 1, &vc_ptr, nullptr);
-        glCompileShader(vid);
-        glGetShaderiv(vid, GL_COMPILE_STATUS, &status);
-        if (!status) {
-            glGetShaderInfoLog(vid, 512, nullptr, infoLog);
-            std::cout << "Vertex shader compilation error: " << infoLog << std::endl;
-            std::abort();
+    // Waits for the program if needed, reports compilation and link errors
+    // and introspects the uniforms. Has to be called before use().
+    void finish() {
+        if (_finished) {
+            return;
         }
 
-        fid = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fid, 1, &fc_ptr, nullptr);
-        glCompileShader(fid);
-        glGetShaderiv(fid, GL_COMPILE_STATUS, &status);
-        if (!status) {
-            glGetShaderInfoLog(vid, 512, nullptr, infoLog);
-            std::cout << "Fragment shader compilation error: " << infoLog << std::endl;
-            std::abort();
+        if (!_loaded_from_cache) {
+            if (!checkCompileAndLink()) {
+                std::abort();
+            }
+            ProgramBinaryCache::Store(ID, _cache_key);
+        }
+
+        loadUniformLocations();
+        bindUniformBlocks();
+
+        _finished = true;
+        auto end = std::chrono::steady_clock::now();
+        _load_time_ms = std::chrono::duration<double, std::milli>(end - _submit_time).count();
+    }
+
+    inline bool finished() const {
+        return _finished;
+    }
+
+    // Rebuilds the program from the current content of its source files.
+    // On success the new program replaces ID and the uniforms are
+    // introspected again (previously resolved locations and handles are
+    // stale and have to be resolved again). On failure the errors are
+    // printed and the previous program is kept. Has to be called on the
+    // thread owning the context, between frames; see ShaderWatcher.
+    bool reload() {
+        std::string vertex_code;
+        std::string fragment_code;
+        if (!readSources(vertex_code, fragment_code)) {
+            return false;
         }
 
+        unsigned int previous_program = ID;
         ID = glCreateProgram();
-        glAttachShader(ID, vid);
-        glAttachShader(ID, fid);
-        glLinkProgram(ID);
-        glGetProgramiv(ID, GL_LINK_STATUS, &status);
-        if (!status) {
-            glGetProgramInfoLog(ID, 512, nullptr, infoLog);
-            std::cout << "Shader program linkage error: " << infoLog << std::endl;
-            std::abort();
+        submitCompileAndLink(vertex_code, fragment_code);
+        if (!checkCompileAndLink()) {
+            glDeleteProgram(ID);
+            ID = previous_program;
+            return false;
         }
+        glDeleteProgram(previous_program);
+
+        _cache_key = ProgramBinaryCache::Key(vertex_code, fragment_code);
+        ProgramBinaryCache::Store(ID, _cache_key);
+
+        _uniforms.clear();
+        loadUniformLocations();
+        bindUniformBlocks();
+        return true;
+    }
+
+    inline const std::string& vertexPath() const {
+        return _vertex_path;
+    }
+
+    inline const std::string& fragmentPath() const {
+        return _fragment_path;
+    }
 
-        glDeleteShader(vid);
-        glDeleteShader(fid);
+    inline bool loadedFromCache() const {
+        return _loaded_from_cache;
+    }
+
+    inline double loadTimeMs() const {
+        return _load_time_ms;
     }
 
     void use() {
         glUseProgram(ID);
     }
 
+    // Returns the location of an active uniform, or -1 if the program
+    // does not use it (same contract as glGetUniformLocation).
+    int uniformLocation(const std::string& name) const {
+        auto it = _uniforms.find(name);
+        if (it == _uniforms.end()) {
+            return -1;
+        }
+        return it->second.location;
+    }
+
+    // Resolves a typed handle. Uniforms the program does not use give an
+    // invalid handle (uploads to it are ignored by GL), while a uniform
+    // declared with a type T cannot be bound to is a programming error.
+    template<typename T>
+    UniformHandle<T> uniform(const std::string& name) const {
+        auto it = _uniforms.find(name);
+        if (it == _uniforms.end()) {
+            return UniformHandle<T>();
+        }
+        if (!UniformTraits<T>::accepts(it->second.type)) {
+            std::cout << "Uniform type mismatch: " << name << std::endl;
+            std::abort();
+        }
+        return UniformHandle<T>(it->second.location);
+    }
+
+    // The value type has to match the handle exactly, so passing a float to
+    // an int uniform (or a vec3 to a mat4 one) does not compile.
+    template<typename T, typename V>
+    void set(const UniformHandle<T>& handle, const V& value) const {
+        static_assert(std::is_same_v<T, V>,
+            "Value type does not match the uniform handle type.");
+        UniformTraits<T>::upload(handle.location(), value);
+    }
+
     void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+        setBool(uniformLocation(name), value);
     }
 
     void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniformLocation(name), value);
     }
 
     void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniformLocation(name), value);
     }
 
     void setVec3(const std::string& name, const glm::vec3& vec) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z);
+        setVec3(uniformLocation(name), vec);
     }
 
     void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(uniformLocation(name), x, y, z);
+    }
+
+    void setMat4(const std::string& name, const glm::mat4& mat) const {
+        setMat4(uniformLocation(name), mat);
+    }
+
+    // Location based setters, meant for the hot paths: resolve the location
+    // once with uniformLocation() and keep it around.
+    void setBool(int location, bool value) const {
+        glUniform1i(location, static_cast<int>(value));
+    }
+
+    void setInt(int location, int value) const {
+        glUniform1i(location, value);
+    }
+
+    void setFloat(int location, float value) const {
+        glUniform1f(location, value);
+    }
+
+    void setVec3(int location, const glm::vec3& vec) const {
+        glUniform3f(location, vec.x, vec.y, vec.z);
+    }
+
+    void setVec3(int location, float x, float y, float z) const {
+        glUniform3f(location, x, y, z);
+    }
+
+    void setMat4(int location, const glm::mat4& mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+private:
+    bool _loaded_from_cache;
+    bool _finished;
+    double _load_time_ms;
+
+    // Kept between submission and finish() to report compilation errors.
+    unsigned int _vertex_shader;
+    unsigned int _fragment_shader;
+    std::string _cache_key;
+    std::string _vertex_path;
+    std::string _fragment_path;
+    Defines _defines;
+    std::chrono::steady_clock::time_point _submit_time;
+
+    struct UniformInfo {
+        int location;
+        GLenum type;
+    };
+
+    std::unordered_map<std::string, UniformInfo> _uniforms;
+
+    // Both sources with _defines applied.
+    bool readSources(std::string& vertex_code, std::string& fragment_code) const {
+        if (!readFile(_vertex_path, vertex_code) ||
+            !readFile(_fragment_path, fragment_code)) {
+            return false;
+        }
+        applyDefines(vertex_code);
+        applyDefines(fragment_code);
+        return true;
+    }
+
+    void applyDefines(std::string& code) const {
+        if (_defines.empty()) {
+            return;
+        }
+        std::string lines;
+        for (const auto& define: _defines) {
+            lines += "#define " + define.first + " " + define.second + "\n";
+        }
+        // #version has to stay the first line.
+        size_t position = 0;
+        if (code.compare(0, 8, "#version") == 0) {
+            size_t end = code.find('\n');
+            position = end == std::string::npos ? code.size() : end + 1;
+        }
+        code.insert(position, lines);
+    }
+
+    static bool readFile(const std::string& path, std::string& content) {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+        try {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            content = stream.str();
+            return true;
+        } catch (const std::ifstream::failure& e) {
+            std::cout << "Failed to load a file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    void submitCompileAndLink(const std::string& vertex_code,
+                              const std::string& fragment_code) {
+        const char* vc_ptr = vertex_code.c_str();
+        const char* fc_ptr = fragment_code.c_str();
+
+        _vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(_vertex_shader, 1, &vc_ptr, nullptr);
+        glCompileShader(_vertex_shader);
+
+        _fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(_fragment_shader, 1, &fc_ptr, nullptr);
+        glCompileShader(_fragment_shader);
+
+        glAttachShader(ID, _vertex_shader);
+        glAttachShader(ID, _fragment_shader);
+        ProgramBinaryCache::PrepareForStore(ID);
+        glLinkProgram(ID);
+    }
+
+    // Reports compilation and link errors, returns false if there were any.
+    // The shader objects are released either way.
+    bool checkCompileAndLink() {
+        int status;
+        char infoLog[512];
+        bool succeeded = true;
+
+        glGetShaderiv(_vertex_shader, GL_COMPILE_STATUS, &status);
+        if (!status) {
+            glGetShaderInfoLog(_vertex_shader, 512, nullptr, infoLog);
+            std::cout << "Vertex shader compilation error: " << infoLog << std::endl;
+            succeeded = false;
+        }
+
+        glGetShaderiv(_fragment_shader, GL_COMPILE_STATUS, &status);
+        if (!status) {
+            glGetShaderInfoLog(_fragment_shader, 512, nullptr, infoLog);
+            std::cout << "Fragment shader compilation error: " << infoLog << std::endl;
+            succeeded = false;
+        }
+
+        if (succeeded) {
+            glGetProgramiv(ID, GL_LINK_STATUS, &status);
+            if (!status) {
+                glGetProgramInfoLog(ID, 512, nullptr, infoLog);
+                std::cout << "Shader program linkage error: " << infoLog << std::endl;
+                succeeded = false;
+            }
+        }
+
+        glDetachShader(ID, _vertex_shader);
+        glDetachShader(ID, _fragment_shader);
+        glDeleteShader(_vertex_shader);
+        glDeleteShader(_fragment_shader);
+        _vertex_shader = 0;
+        _fragment_shader = 0;
+        return succeeded;
+    }
+
+    // Binds every shared uniform block the program declares to its fixed
+    // binding point, see UniformBlockBindings().
+    void bindUniformBlocks() {
+        int blocks_count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks_count);
+
+        int max_name_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_name_length);
+        std::vector<char> name_buffer(max_name_length + 1);
+
+        const auto& bindings = UniformBlockBindings();
+        for (int i = 0; i < blocks_count; i++) {
+            int name_length = 0;
+            glGetActiveUniformBlockName(ID, i, name_buffer.size(),
+                &name_length, name_buffer.data());
+
+            auto it = bindings.find(std::string(name_buffer.data(), name_length));
+            if (it == bindings.end()) {
+                continue;
+            }
+            glUniformBlockBinding(ID, i, static_cast<unsigned int>(it->second));
+        }
+    }
+
+    // Introspects all active uniforms once after link, so that setters never
+    // have to ask the driver for a location again.
+    void loadUniformLocations() {
+        int uniforms_count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniforms_count);
+
+        int max_name_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+        std::vector<char> name_buffer(max_name_length + 1);
+
+        _uniforms.reserve(uniforms_count);
+        for (int i = 0; i < uniforms_count; i++) {
+            int name_length = 0;
+            int size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, name_buffer.size(), &name_length,
+                &size, &type, name_buffer.data());
+
+            std::string name(name_buffer.data(), name_length);
+            int location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0) {
+                // Uniform block members do not have a location.
+                continue;
+            }
+            _uniforms[name] = { location, type };
+
+            // Arrays are reported once as "name[0]", register the bare name
+            // and every element so that "name[i]" lookups hit the table too.
+            const std::string array_suffix = "[0]";
+            if (name.size() > array_suffix.size() &&
+                name.compare(name.size() - array_suffix.size(),
+                    array_suffix.size(), array_suffix) == 0) {
+                std::string base = name.substr(0, name.size() - array_suffix.size());
+                _uniforms[base] = { location, type };
+                for (int j = 1; j < size; j++) {
+                    std::string element = base + "[" + std::to_string(j) + "]";
+                    _uniforms[element] = {
+                        glGetUniformLocation(ID, element.c_str()), type };
+                }
+            }
+        }
     }
 };
 
@@ -2,18 +2,23 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
 layout (location = 2) in vec2 aTexCoords;
+// Per instance, see instanced_batch.h.
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in int aMaterial;
+layout (location = 8) in mat3 aNormalMatrix;
 
 out vec3 fNorm;
 out vec3 fPos;
 out vec2 TexCoords;
+flat out int fMaterial;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    fNorm = mat3(transpose(inverse(model))) * aNorm;
-    fPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    fNorm = aNormalMatrix * aNorm;
+    fPos = vec3(aModel * vec4(aPos, 1.0));
     TexCoords = aTexCoords;
+    fMaterial = aMaterial;
 }
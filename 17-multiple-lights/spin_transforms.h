@@ -0,0 +1,47 @@
+#ifndef __SPIN_TRANSFORMS_H__
+#define __SPIN_TRANSFORMS_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+
+#include "job_system.h"
+
+// An object spinning in place around axis.
+struct Spin {
+    glm::vec3 position;
+    glm::vec3 axis;
+    float degrees_per_second;
+    float phase_degrees;
+};
+
+// Indices per job, a few hundred KB of matrices.
+constexpr size_t kSpinTransformsGrain = 4096;
+
+// Model matrices of spins [begin, end) at time, in seconds.
+inline void ComputeSpinTransforms(const Spin* spins, size_t begin, size_t end, float time,
+                                  glm::mat4* transforms) {
+    for (size_t i = begin; i < end; i++) {
+        const Spin& spin = spins[i];
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), spin.position);
+        transforms[i] = glm::rotate(model,
+            glm::radians(spin.phase_degrees + time * spin.degrees_per_second), spin.axis);
+    }
+}
+
+// Starts computing the model matrices of every spin into transforms on
+// jobs. spins and transforms have to stay alive, and transforms untouched,
+// until the returned loop is waited on.
+inline JobSystem::Handle DispatchSpinTransforms(JobSystem& jobs, const std::vector<Spin>& spins,
+                                                float time, std::vector<glm::mat4>& transforms) {
+    const Spin* source = spins.data();
+    glm::mat4* destination = transforms.data();
+    return jobs.Dispatch(spins.size(), kSpinTransformsGrain,
+        [source, destination, time](size_t begin, size_t end) {
+            ComputeSpinTransforms(source, begin, end, time, destination);
+        });
+}
+
+#endif  // __SPIN_TRANSFORMS_H__
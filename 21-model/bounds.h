@@ -0,0 +1,54 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+
+#include <algorithm>
+#include <cmath>
+
+#include "glm.hpp"
+
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// Sphere centered on the box and just large enough for the points, which
+// is tighter than the sphere around the box whenever the points do not
+// fill its corners. stride is the distance between two points in bytes.
+inline BoundingSphere BoundingSphereOf(const BoundingBox& box, const void* points,
+                                       size_t count, size_t stride) {
+    BoundingSphere sphere = { (box.min + box.max) * 0.5f, 0.0f };
+    float radius_squared = 0.0f;
+    const unsigned char* point = static_cast<const unsigned char*>(points);
+    for (size_t i = 0; i < count; i++, point += stride) {
+        glm::vec3 offset = *reinterpret_cast<const glm::vec3*>(point) - sphere.center;
+        radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radius_squared);
+    return sphere;
+}
+
+// The box around box once transformed (Arvo): the center is transformed,
+// the extents are projected on the axes of the transform.
+inline BoundingBox Transformed(const BoundingBox& box, const glm::mat4& transform) {
+    glm::vec3 center = glm::vec3(transform * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::vec3 transformed_extent(0.0f);
+    for (int i = 0; i < 3; i++) {
+        transformed_extent += glm::abs(glm::vec3(transform[i])) * extent[i];
+    }
+    return { center - transformed_extent, center + transformed_extent };
+}
+
+// The sphere grows by the largest scale of transform.
+inline BoundingSphere Transformed(const BoundingSphere& sphere, const glm::mat4& transform) {
+    float scale = std::max({ glm::length(glm::vec3(transform[0])),
+        glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+    return { glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale };
+}
+
+#endif  // __BOUNDS_H__
@@ -0,0 +1,328 @@
+#ifndef __DRAW_BATCHES_H__
+#define __DRAW_BATCHES_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glad.h>
+#include "glm.hpp"
+
+#include "mesh.h"
+#include "shader.h"
+
+// Layout of a GL_DRAW_INDIRECT_BUFFER entry for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Meshes of a MeshArena grouped by material (their textures), each group
+// drawn with one multi draw call instead of a draw per mesh.
+//
+// With ARB_multi_draw_indirect and ARB_base_instance the commands of every
+// batch live in one GL_DRAW_INDIRECT_BUFFER and are issued with
+// glMultiDrawElementsIndirect. Without the latter baseInstance has to be 0,
+// and every command would read the layers and transform of the first.
+// Otherwise (e.g. on macOS) the same ranges go through
+// glMultiDrawElementsBaseVertex, which core GL 3.3 provides.
+//
+// Meshes are drawn in material order, not in the order of the model.
+//
+// Meshes whose textures are packed in the same TextureArrays only differ by
+// their layers. The indirect path still draws them together: each command
+// gets its own baseInstance, which fetches its layers from a per instance
+// kMaterialLayersAttribute in the arena VAO. Node transforms are fetched
+// the same way from a per instance kNodeTransformAttribute, refreshed by
+// SetTransforms. The fallback has no per draw data, so it splits batches
+// by layers and by node as well.
+//
+// Meshes can be left out per frame (e.g. frustum culled) without building
+// the batches again: the indirect path sets the instanceCount of their
+// commands to 0, the fallback draws the remaining ranges of each batch.
+class DrawBatches {
+public:
+    // vao is the one of the arena the meshes live in, nodes[i] the scene
+    // graph node of meshes[i].
+    DrawBatches(const std::vector<Mesh>& meshes, const std::vector<uint32_t>& nodes,
+                unsigned int vao) noexcept
+        : _indirect(false), _indirect_buffer(0), _layers_buffer(0), _transforms_buffer(0) {
+#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+        _indirect = GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+#endif
+        bool packed = false;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            for (const auto& texture: meshes[i].textures()) {
+                packed = packed || texture.target == GL_TEXTURE_2D_ARRAY;
+            }
+
+            Batch* batch = nullptr;
+            for (auto& candidate: _batches) {
+                if (SameTextures(meshes[candidate.first_mesh], meshes[i], !_indirect) &&
+                    (_indirect || nodes[candidate.first_mesh] == nodes[i])) {
+                    batch = &candidate;
+                    break;
+                }
+            }
+            if (!batch) {
+                _batches.push_back({ i, meshes[i].range().index_type });
+                batch = &_batches.back();
+            }
+
+            const MeshRange& range = meshes[i].range();
+            batch->counts.push_back(static_cast<GLsizei>(range.indices_count));
+            batch->offsets.push_back(reinterpret_cast<const void*>(range.index_offset));
+            batch->base_vertices.push_back(range.base_vertex);
+            batch->meshes.push_back(i);
+        }
+
+        if (_indirect) {
+            std::vector<GLint> layers;
+            for (auto& batch: _batches) {
+                batch.first_command = _commands.size();
+                size_t index_size = IndexSize(batch.index_type);
+                for (size_t i = 0; i < batch.counts.size(); i++) {
+                    GLuint base_instance = static_cast<GLuint>(_commands.size());
+                    _commands.push_back({
+                        static_cast<GLuint>(batch.counts[i]), 1,
+                        static_cast<GLuint>(reinterpret_cast<size_t>(batch.offsets[i]) / index_size),
+                        batch.base_vertices[i], base_instance });
+
+                    const auto& textures = meshes[batch.meshes[i]].textures();
+                    for (size_t j = 0; j < kMaxMaterialLayers; j++) {
+                        layers.push_back(j < textures.size() ? textures[j].layer : 0);
+                    }
+                }
+            }
+
+            if (packed) {
+                glGenBuffers(1, &_layers_buffer);
+                glBindVertexArray(vao);
+                glBindBuffer(GL_ARRAY_BUFFER, _layers_buffer);
+                glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(GLint),
+                    layers.data(), GL_STATIC_DRAW);
+                // Left disabled, Draw enables it for the multi draw only.
+                glVertexAttribIPointer(kMaterialLayersAttribute, kMaxMaterialLayers, GL_INT,
+                    0, nullptr);
+                glVertexAttribDivisor(kMaterialLayersAttribute, 1);
+                glBindVertexArray(0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+
+            // Filled by SetTransforms, left disabled like the layers.
+            glGenBuffers(1, &_transforms_buffer);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, _transforms_buffer);
+            glBufferData(GL_ARRAY_BUFFER, _commands.size() * sizeof(glm::mat4),
+                nullptr, GL_DYNAMIC_DRAW);
+            for (GLuint i = 0; i < 4; i++) {
+                glVertexAttribPointer(kNodeTransformAttribute + i, 4, GL_FLOAT, GL_FALSE,
+                    sizeof(glm::mat4), reinterpret_cast<void*>(i * sizeof(glm::vec4)));
+                glVertexAttribDivisor(kNodeTransformAttribute + i, 1);
+            }
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            SetTransforms(meshes);
+
+            glGenBuffers(1, &_indirect_buffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                _commands.size() * sizeof(DrawElementsIndirectCommand),
+                _commands.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    }
+
+    DrawBatches(const DrawBatches&) = delete;
+    DrawBatches& operator=(const DrawBatches&) = delete;
+
+    ~DrawBatches() {
+        if (_indirect_buffer) {
+            glDeleteBuffers(1, &_indirect_buffer);
+        }
+        if (_layers_buffer) {
+            glDeleteBuffers(1, &_layers_buffer);
+        }
+        if (_transforms_buffer) {
+            glDeleteBuffers(1, &_transforms_buffer);
+        }
+    }
+
+    // Uploads the node transforms of the meshes for the indirect path, the
+    // fallback sets them per draw. Needed whenever a node moved.
+    void SetTransforms(const std::vector<Mesh>& meshes) {
+        if (!_transforms_buffer) {
+            return;
+        }
+        std::vector<glm::mat4> transforms(_commands.size());
+        for (const auto& batch: _batches) {
+            for (size_t i = 0; i < batch.meshes.size(); i++) {
+                transforms[batch.first_command + i] = meshes[batch.meshes[i]].transform();
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, _transforms_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, transforms.size() * sizeof(glm::mat4),
+            transforms.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Expects the VAO of the arena the meshes live in to be bound. Only
+    // the meshes with visible[i] set are drawn, all of them without
+    // visible. Returns the number of draw calls issued, batches without
+    // any visible mesh are skipped.
+    size_t Draw(const Shader& shader, const MeshUniforms& uniforms,
+                const std::vector<Mesh>& meshes,
+                const std::vector<uint8_t>* visible = nullptr) {
+        if (_indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+            UpdateInstanceCounts(visible);
+        }
+        if (_layers_buffer) {
+            glEnableVertexAttribArray(kMaterialLayersAttribute);
+        }
+        SetTransformsEnabled(true);
+
+        size_t draw_calls = 0;
+        for (auto& batch: _batches) {
+            GLsizei count = static_cast<GLsizei>(batch.counts.size());
+            const GLsizei* counts = batch.counts.data();
+            const void* const* offsets = batch.offsets.data();
+            const GLint* base_vertices = batch.base_vertices.data();
+            if (visible) {
+                count = Filter(batch, *visible);
+                if (count == 0) {
+                    continue;
+                }
+                counts = batch.visible_counts.data();
+                offsets = batch.visible_offsets.data();
+                base_vertices = batch.visible_base_vertices.data();
+            }
+
+            meshes[batch.first_mesh].Bind(shader, uniforms);
+            draw_calls++;
+#ifdef GL_ARB_multi_draw_indirect
+            if (_indirect) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, batch.index_type,
+                    reinterpret_cast<const void*>(batch.first_command * sizeof(DrawElementsIndirectCommand)),
+                    static_cast<GLsizei>(batch.counts.size()), 0);
+                continue;
+            }
+#endif
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, batch.index_type,
+                offsets, count, base_vertices);
+        }
+
+        if (_indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        if (_layers_buffer) {
+            glDisableVertexAttribArray(kMaterialLayersAttribute);
+        }
+        SetTransformsEnabled(false);
+        return draw_calls;
+    }
+
+    // Draw calls a Draw() of every mesh issues.
+    inline size_t size() const {
+        return _batches.size();
+    }
+
+    inline bool indirect() const {
+        return _indirect;
+    }
+
+private:
+    struct Batch {
+        // Provides the textures and uniforms of the batch.
+        size_t first_mesh;
+        GLenum index_type;
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> base_vertices;
+        std::vector<size_t> meshes;
+        size_t first_command = 0;
+        // The ranges of the visible meshes, rebuilt by every culled Draw.
+        std::vector<GLsizei> visible_counts;
+        std::vector<const void*> visible_offsets;
+        std::vector<GLint> visible_base_vertices;
+    };
+
+    std::vector<Batch> _batches;
+    bool _indirect;
+    unsigned int _indirect_buffer;
+    // What the indirect buffer holds, to only upload instance counts that
+    // changed.
+    std::vector<DrawElementsIndirectCommand> _commands;
+    // Layers per command, only for meshes using TextureArrays.
+    unsigned int _layers_buffer;
+    // Node transform per command, indirect path only.
+    unsigned int _transforms_buffer;
+
+    void SetTransformsEnabled(bool enabled) {
+        if (!_transforms_buffer) {
+            return;
+        }
+        for (GLuint i = 0; i < 4; i++) {
+            enabled ? glEnableVertexAttribArray(kNodeTransformAttribute + i)
+                    : glDisableVertexAttribArray(kNodeTransformAttribute + i);
+        }
+    }
+
+    // Sets the instanceCount of every command to 1 if its mesh is visible,
+    // 0 otherwise, and uploads the span of commands that changed.
+    void UpdateInstanceCounts(const std::vector<uint8_t>* visible) {
+        size_t first = _commands.size();
+        size_t last = 0;
+        for (const auto& batch: _batches) {
+            for (size_t i = 0; i < batch.meshes.size(); i++) {
+                GLuint instances = !visible || (*visible)[batch.meshes[i]] ? 1 : 0;
+                DrawElementsIndirectCommand& command = _commands[batch.first_command + i];
+                if (command.instanceCount != instances) {
+                    command.instanceCount = instances;
+                    first = std::min(first, batch.first_command + i);
+                    last = std::max(last, batch.first_command + i + 1);
+                }
+            }
+        }
+        if (first < last) {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, first * sizeof(DrawElementsIndirectCommand),
+                (last - first) * sizeof(DrawElementsIndirectCommand), _commands.data() + first);
+        }
+    }
+
+    // Gathers the ranges of the visible meshes of batch, returns how many.
+    static GLsizei Filter(Batch& batch, const std::vector<uint8_t>& visible) {
+        batch.visible_counts.clear();
+        batch.visible_offsets.clear();
+        batch.visible_base_vertices.clear();
+        for (size_t i = 0; i < batch.meshes.size(); i++) {
+            if (visible[batch.meshes[i]]) {
+                batch.visible_counts.push_back(batch.counts[i]);
+                batch.visible_offsets.push_back(batch.offsets[i]);
+                batch.visible_base_vertices.push_back(batch.base_vertices[i]);
+            }
+        }
+        return static_cast<GLsizei>(batch.visible_counts.size());
+    }
+
+    static bool SameTextures(const Mesh& a, const Mesh& b, bool compare_layers) {
+        if (a.textures().size() != b.textures().size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.textures().size(); i++) {
+            if (a.textures()[i].id != b.textures()[i].id ||
+                a.textures()[i].type != b.textures()[i].type) {
+                return false;
+            }
+            if (compare_layers && a.textures()[i].layer != b.textures()[i].layer) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif  // __DRAW_BATCHES_H__
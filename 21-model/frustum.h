@@ -0,0 +1,170 @@
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+#include <cmath>
+#include <cstdint>
+
+#include "glm.hpp"
+
+#include "bounds.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// The six planes of a view frustum, extracted from a projection * view
+// matrix (Gribb and Hartmann). Multiplied by a model matrix too, the planes
+// are in model space and the bounds of a mesh can be tested as they are.
+//
+// A volume is culled when it lies entirely behind one plane. Boxes are
+// tested as center and half extents against all planes at once: the
+// planes are stored as structure of arrays, padded to eight with planes
+// nothing is behind, and each group of four is one SSE multiply-add chain.
+// The test is conservative, a box close to a corner of the frustum may be
+// reported visible while it is not.
+class Frustum {
+public:
+    enum class Containment {
+        kOutside,
+        kIntersects,
+        kInside,
+    };
+
+    // Planes are normalized, so that sphere tests compare true distances.
+    explicit Frustum(const glm::mat4& clip) noexcept {
+        // Rows of the matrix, GLM stores columns.
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        }
+        const glm::vec4 planes[kPlanes] = {
+            rows[3] + rows[0],  // left
+            rows[3] - rows[0],  // right
+            rows[3] + rows[1],  // bottom
+            rows[3] - rows[1],  // top
+            rows[3] + rows[2],  // near
+            rows[3] - rows[2],  // far
+        };
+
+        for (int i = 0; i < kLanes; i++) {
+            glm::vec4 plane = i < kPlanes ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) {
+                plane /= length;
+            }
+            _nx[i] = plane.x;
+            _ny[i] = plane.y;
+            _nz[i] = plane.z;
+            _d[i] = plane.w;
+            _ax[i] = std::fabs(plane.x);
+            _ay[i] = std::fabs(plane.y);
+            _az[i] = std::fabs(plane.z);
+        }
+    }
+
+    bool Intersects(const BoundingSphere& sphere) const {
+        return !Behind(sphere.center, glm::vec3(0.0f), sphere.radius);
+    }
+
+    bool Intersects(const BoundingBox& box) const {
+        return !Behind((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f, 0.0f);
+    }
+
+    // Like Intersects, but also tells boxes entirely inside apart, whose
+    // content (e.g. a BVH subtree) needs no further test.
+    Containment Classify(const BoundingBox& box) const {
+        const glm::vec3 c = (box.min + box.max) * 0.5f;
+        const glm::vec3 e = (box.max - box.min) * 0.5f;
+        bool inside = true;
+#ifdef FRUSTUM_SSE
+        const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+        const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+        for (int i = 0; i < kLanes; i += 4) {
+            // Distance of the center and projected radius of the box.
+            __m128 distance = _mm_load_ps(_d + i);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_nx + i), cx));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_ny + i), cy));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_nz + i), cz));
+            __m128 radius = _mm_mul_ps(_mm_load_ps(_ax + i), ex);
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_load_ps(_ay + i), ey));
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_load_ps(_az + i), ez));
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()))) {
+                return Containment::kOutside;
+            }
+            inside = inside && !_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+        }
+#else
+        for (int i = 0; i < kPlanes; i++) {
+            float distance = _nx[i] * c.x + _ny[i] * c.y + _nz[i] * c.z + _d[i];
+            float radius = _ax[i] * e.x + _ay[i] * e.y + _az[i] * e.z;
+            if (distance + radius < 0.0f) {
+                return Containment::kOutside;
+            }
+            inside = inside && distance - radius >= 0.0f;
+        }
+#endif
+        return inside ? Containment::kInside : Containment::kIntersects;
+    }
+
+    // Tests count volumes, the cheaper sphere first, and sets visible[i] to
+    // 1 or 0. Returns the number of visible ones.
+    size_t Cull(const BoundingBox* boxes, const BoundingSphere* spheres,
+                size_t count, uint8_t* visible) const {
+        size_t visible_count = 0;
+        for (size_t i = 0; i < count; i++) {
+            bool inside = Intersects(spheres[i]) && Intersects(boxes[i]);
+            visible[i] = inside ? 1 : 0;
+            visible_count += inside ? 1 : 0;
+        }
+        return visible_count;
+    }
+
+private:
+    static constexpr int kPlanes = 6;
+    static constexpr int kLanes = 8;
+
+    // Normals, their absolute values and distances, one lane per plane.
+    alignas(16) float _nx[kLanes];
+    alignas(16) float _ny[kLanes];
+    alignas(16) float _nz[kLanes];
+    alignas(16) float _d[kLanes];
+    alignas(16) float _ax[kLanes];
+    alignas(16) float _ay[kLanes];
+    alignas(16) float _az[kLanes];
+
+    // True if the box of center c and half extents e, grown by radius, is
+    // entirely behind one of the planes.
+    bool Behind(const glm::vec3& c, const glm::vec3& e, float radius) const {
+#ifdef FRUSTUM_SSE
+        const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+        const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+        const __m128 r = _mm_set1_ps(radius);
+        for (int i = 0; i < kLanes; i += 4) {
+            // n.c + d + |n|.e + radius, negative when behind the plane.
+            __m128 distance = _mm_add_ps(_mm_load_ps(_d + i), r);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_nx + i), cx));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_ny + i), cy));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_nz + i), cz));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_ax + i), ex));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_ay + i), ey));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(_az + i), ez));
+            if (_mm_movemask_ps(_mm_cmplt_ps(distance, _mm_setzero_ps()))) {
+                return true;
+            }
+        }
+        return false;
+#else
+        for (int i = 0; i < kPlanes; i++) {
+            float distance = _nx[i] * c.x + _ny[i] * c.y + _nz[i] * c.z + _d[i]
+                + _ax[i] * e.x + _ay[i] * e.y + _az[i] * e.z + radius;
+            if (distance < 0.0f) {
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+};
+
+#endif  // __FRUSTUM_H__
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <format>
+#include <chrono>
+#include <memory>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
@@ -10,6 +12,7 @@
 #include "gtc/type_ptr.hpp"
 
 #include "camera.h"
+#include "frustum.h"
 #include "shader.h"
 #include "model.h"
 
@@ -98,14 +101,30 @@ int main() {
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("shader.vs", "shader.fs");
-    Model object("./backpack/backpack.obj");
-
-    unsigned int modelLoc = glGetUniformLocation(shader.ID, "model");
-    unsigned int viewLoc = glGetUniformLocation(shader.ID, "view");
-    unsigned int projectionLoc = glGetUniformLocation(shader.ID, "projection");
+    // Samples the material textures once the model packed them in arrays.
+    Shader array_shader("shader.vs", "shader_array.fs");
+    // Only compiled on drivers with ARB_bindless_texture, once the arrays
+    // have handles.
+    std::unique_ptr<Shader> bindless_array_shader;
+    Shader* current_shader = &shader;
+
+    // Cold loads go through Assimp, warm ones map backpack.obj.meshcache.
+    auto load_begin = std::chrono::steady_clock::now();
+    // Owned here so that its textures are released before the context.
+    auto object = std::make_unique<Model>("./backpack/backpack.obj",
+        VertexFormat::kQuantized, MeshLayout::kArena);
+    auto load_end = std::chrono::steady_clock::now();
+    std::cout << "Model loaded in "
+              << std::chrono::duration<double, std::milli>(load_end - load_begin).count()
+              << " ms, " << object->vertexBufferSize() / 1e6 << " MB of vertices, "
+              << object->indexBufferSize() / 1e6 << " MB of indices, "
+              << object->scene().size() << " nodes" << std::endl;
+
+    bool textures_uploaded = false;
 
     float dt = 0.0f;
     float last_frame = 0.0f;
+    float stats_time = 0.0f;
     while (!glfwWindowShouldClose(window)) {
         float current_frame = static_cast<float>(glfwGetTime());
         dt = current_frame - last_frame;
@@ -117,24 +136,58 @@ int main() {
         glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shader.use();
+        // Textures decode in the background, upload a few per frame.
+        // Once they are all there, they get packed in texture arrays.
+        if (!textures_uploaded && object->UploadTextures(std::chrono::milliseconds(4))) {
+            textures_uploaded = true;
+            const TextureCache& textures = TextureCache::Shared();
+            PixelUploadStats uploads = textures.uploadStats();
+            std::cout << "Textures uploaded: " << uploads.bytes / 1e6 << " MB at "
+                      << uploads.megabytesPerSecond() << " MB/s, cache "
+                      << textures.hits() << " hits / " << textures.misses() << " misses"
+                      << std::endl;
+
+            size_t arrays = object->PackTextures();
+            current_shader = &array_shader;
+            if (object->textureArrays()->bindless()) {
+                bindless_array_shader = std::make_unique<Shader>("shader.vs",
+                    "shader_array_bindless.fs");
+                current_shader = bindless_array_shader.get();
+            }
+            std::cout << "Textures packed in " << arrays << " arrays, "
+                      << object->textureArrays()->bytes() / 1e6 << " MB"
+                      << (object->textureArrays()->bindless() ? ", bindless" : "")
+                      << std::endl;
+        }
+
+        Shader& active = *current_shader;
+        active.use();
         glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()),
             static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(camera.view()));
+        active.setMat4("projection", projection);
+        active.setMat4("view", camera.view());
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        active.setMat4("model", model);
 
-        object.Draw(shader);
+        // Submeshes outside the view are not submitted at all.
+        object->Cull(Frustum(projection * camera.view() * model));
+        object->DrawBatched(active);
+
+        if (current_frame - stats_time >= 1.0f) {
+            std::cout << "Meshes per frame: " << object->visibleMeshes() << " visible, "
+                      << object->culledMeshes() << " culled, "
+                      << object->drawCalls() << " draw calls" << std::endl;
+            stats_time = current_frame;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
-    
+
+    object.reset();
     glfwTerminate();
     return 0;
 }
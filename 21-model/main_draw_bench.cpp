@@ -0,0 +1,202 @@
+// Draw submission benchmark for Model.
+// Loads a model twice, with a VAO per mesh and packed in a MeshArena, and
+// measures the CPU time spent to submit a frame and the draw calls it
+// takes when
+//  - every mesh is drawn with its own VAO (MeshLayout::kSeparate),
+//  - every mesh is drawn from the arena, one VAO bind per frame,
+//  - the arena meshes are drawn per material with DrawBatched
+//    (glMultiDrawElementsIndirect or glMultiDrawElementsBaseVertex),
+//  - the meshes of both models go through a RenderQueue, which sorts them
+//    and skips redundant state changes,
+//  - the arena meshes are drawn batched once their textures are packed in
+//    TextureArrays, so that materials only differ by layer.
+//
+// The gap grows with the number of submeshes, pass a scene with thousands
+// of them to see it.
+//
+// Usage: ./main_draw_bench [model path, default ./backpack/backpack.obj]
+// Runs in an invisible window, so it works under headless Mesa as well:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe xvfb-run ./main_draw_bench
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+#include "gtc/type_ptr.hpp"
+
+#include "shader.h"
+#include "model.h"
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+namespace {
+
+constexpr int kWarmupFrames = 20;
+constexpr int kFrames = 300;
+
+// Runs the frame body kFrames times and returns the average CPU time it
+// took to submit a frame, in milliseconds. glFinish between frames keeps
+// the driver queue from growing, and is not part of the measurement.
+template<typename F>
+double MeasureFrameMs(F&& frame) {
+    for (int i = 0; i < kWarmupFrames; i++) {
+        frame();
+        glFinish();
+    }
+
+    double total_ms = 0.0;
+    for (int i = 0; i < kFrames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        frame();
+        auto end = std::chrono::steady_clock::now();
+        total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        glFinish();
+    }
+    return total_ms / kFrames;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string model_path = "./backpack/backpack.obj";
+    if (argc > 1) {
+        model_path = argv[1];
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+    if (!window) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cout << "Failed to initialised GLAD" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    Shader shader("shader.vs", "shader.fs");
+    Shader array_shader("shader.vs", "shader_array.fs");
+
+    // The second model maps the mesh cache written by the first one and
+    // shares its textures through the TextureCache.
+    auto separate = std::make_unique<Model>(model_path,
+        VertexFormat::kFloat, MeshLayout::kSeparate);
+    auto arena = std::make_unique<Model>(model_path,
+        VertexFormat::kFloat, MeshLayout::kArena);
+    TextureCache::Shared().Finish();
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
+        glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+        static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(0.1f, 0.1f, 0.1f));
+    for (Shader* program: { &shader, &array_shader }) {
+        program->use();
+        program->setMat4("view", view);
+        program->setMat4("projection", projection);
+        program->setMat4("model", model);
+    }
+    shader.use();
+
+    auto clear = []() {
+        glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    };
+
+    double separate_ms = MeasureFrameMs([&]() {
+        clear();
+        separate->Draw(shader);
+    });
+    size_t separate_calls = separate->drawCalls();
+
+    double arena_ms = MeasureFrameMs([&]() {
+        clear();
+        arena->Draw(shader);
+    });
+    size_t arena_calls = arena->drawCalls();
+
+    double batched_ms = MeasureFrameMs([&]() {
+        clear();
+        arena->DrawBatched(shader);
+    });
+    size_t batched_calls = arena->drawCalls();
+
+    RenderQueue queue;
+    double queue_ms = MeasureFrameMs([&]() {
+        clear();
+        separate->Enqueue(queue, shader, 0.5f);
+        arena->Enqueue(queue, shader, 0.5f);
+        queue.Flush();
+    });
+    const RenderQueue::Stats& queue_stats = queue.stats();
+
+    size_t arrays = arena->PackTextures();
+    // Resident handles need a sampler declared bindless.
+    std::unique_ptr<Shader> bindless_array_shader;
+    Shader* packed_shader = &array_shader;
+    if (arena->textureArrays()->bindless()) {
+        bindless_array_shader = std::make_unique<Shader>("shader.vs", "shader_array_bindless.fs");
+        packed_shader = bindless_array_shader.get();
+        packed_shader->use();
+        packed_shader->setMat4("view", view);
+        packed_shader->setMat4("projection", projection);
+        packed_shader->setMat4("model", model);
+    }
+    packed_shader->use();
+    double packed_ms = MeasureFrameMs([&]() {
+        clear();
+        arena->DrawBatched(*packed_shader);
+    });
+    size_t packed_calls = arena->drawCalls();
+
+    std::cout << "Per mesh VAO:      " << separate_ms << " ms/frame, "
+              << separate_calls << " draw calls" << std::endl;
+    std::cout << "Arena, per mesh:   " << arena_ms << " ms/frame, "
+              << arena_calls << " draw calls" << std::endl;
+    std::cout << "Arena, batched:    " << batched_ms << " ms/frame, "
+              << batched_calls << " draw calls ("
+              << (arena->drawsIndirect() ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex")
+              << ")" << std::endl;
+    std::cout << "Render queue (both models): " << queue_ms << " ms/frame, "
+              << queue_stats.draws << " draw calls" << std::endl;
+    std::cout << "  skipped: " << queue_stats.program_binds_skipped << " program binds, "
+              << queue_stats.vao_binds_skipped << " VAO binds, "
+              << queue_stats.texture_binds_skipped << " texture binds, "
+              << queue_stats.uniform_sets_skipped << " uniform sets" << std::endl;
+    std::cout << "  issued:  " << queue_stats.program_binds << " program binds, "
+              << queue_stats.vao_binds << " VAO binds, "
+              << queue_stats.texture_binds << " texture binds, "
+              << queue_stats.uniform_sets << " uniform sets" << std::endl;
+    std::cout << "Arena, batched, texture arrays: " << packed_ms << " ms/frame, "
+              << packed_calls << " draw calls, " << arrays << " arrays"
+              << (arena->textureArrays()->bindless() ? " (bindless)" : "") << std::endl;
+
+    separate.reset();
+    arena.reset();
+    glfwTerminate();
+    return 0;
+}
@@ -1,79 +1,353 @@
 #ifndef __MESH_H__
 #define __MESH_H__
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include "glm.hpp"
 #include <glad.h>
 
+#include "bounds.h"
 #include "shader.h"
-
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-};
+#include "texture_array.h"
+#include "vertex_format.h"
 
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
+    // Set once the texture is packed into TextureArrays.
+    GLenum target = GL_TEXTURE_2D;
+    GLint layer = 0;
+    GLuint64 handle = 0;
+};
+
+// Generic vertex attribute holding the array layer of each texture of the
+// mesh being drawn (ivec4, in the order of Mesh::textures()). Set per draw
+// as a constant attribute, or per instance by DrawBatches.
+constexpr GLuint kMaterialLayersAttribute = 3;
+constexpr size_t kMaxMaterialLayers = 4;
+
+// Generic vertex attribute (mat4, four locations) holding the transform of
+// the scene graph node the mesh hangs from, relative to the model matrix.
+// Set per draw as a constant attribute, or per instance by DrawBatches.
+constexpr GLuint kNodeTransformAttribute = 4;
+
+// Sampler uniforms a mesh may use: texture_diffuse1 to texture_diffuse4,
+// then texture_specular1 to texture_specular4. Each texture of a mesh maps
+// to one of these slots, see Mesh::samplerSlots().
+constexpr size_t kSamplersPerType = 4;
+constexpr size_t kSamplerSlots = 2 * kSamplersPerType;
+// Textures past the fourth of their type, bound but without a sampler.
+constexpr uint8_t kNoSamplerSlot = 0xFF;
+
+inline std::string SamplerName(size_t slot) {
+    return (slot < kSamplersPerType ? "texture_diffuse" : "texture_specular")
+        + std::to_string(slot % kSamplersPerType + 1);
+}
+
+// Uniforms Mesh::Bind sets, resolved once per program rather than looked up
+// by name on every draw.
+struct MeshUniforms {
+    UniformHandle<glm::vec3> position_scale;
+    UniformHandle<glm::vec3> position_offset;
+    // Location of every sampler slot, -1 when the program does not use it.
+    int samplers[kSamplerSlots];
+
+    MeshUniforms() noexcept {
+        std::fill(std::begin(samplers), std::end(samplers), -1);
+    }
+
+    static MeshUniforms Resolve(const Shader& shader) {
+        MeshUniforms uniforms;
+        uniforms.position_scale = shader.uniform<glm::vec3>("positionScale");
+        uniforms.position_offset = shader.uniform<glm::vec3>("positionOffset");
+        for (size_t i = 0; i < kSamplerSlots; i++) {
+            uniforms.samplers[i] = shader.uniformLocation(SamplerName(i));
+        }
+        return uniforms;
+    }
+};
+
+// A texture of a material before it is loaded, path is relative to the model.
+struct TextureRef {
+    std::string type;
+    std::string path;
+};
+
+// CPU side result of importing a mesh, before anything is uploaded.
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<TextureRef> textures;
+    BoundingBox bounds;
+    BoundingSphere sphere;
+    // Scene graph node the mesh hangs from, see SceneGraph.
+    uint32_t node;
+};
+
+// Indices of a mesh within the buffers it is drawn from; base_vertex and
+// index_offset are 0 unless the buffers are shared (see MeshArena).
+struct MeshRange {
+    GLint base_vertex;
+    size_t index_offset;
+    size_t indices_count;
+    GLenum index_type;
 };
 
+// Writes count indices at offset (in bytes) of the buffer bound to
+// GL_ELEMENT_ARRAY_BUFFER, narrowed to 16 bits for GL_UNSIGNED_SHORT.
+inline void UploadIndices(GLintptr offset, GLenum type,
+                          const unsigned int* indices, size_t count) {
+    if (type == GL_UNSIGNED_SHORT) {
+        std::vector<uint16_t> narrow(indices, indices + count);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, count * sizeof(uint16_t), narrow.data());
+    } else {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, count * sizeof(unsigned int), indices);
+    }
+}
+
+// GL_UNSIGNED_SHORT whenever every vertex can be addressed with 16 bits.
+inline GLenum IndexType(size_t vertices_count) {
+    return vertices_count <= std::numeric_limits<uint16_t>::max() + size_t(1)
+        ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t IndexSize(GLenum type) {
+    return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+}
+
 class Mesh {
 public:
-    Mesh(std::vector<Vertex> vertices,
-         std::vector<unsigned int> indices,
-         std::vector<Texture> textures) noexcept :
-         _vertices(vertices),
-         _indices(indices),
+    // Vertices and indices are only read during construction, they may
+    // point straight into a mapped MeshCache file. The vertices are packed
+    // into format on upload.
+    Mesh(const Vertex* vertices,
+         size_t vertices_count,
+         const unsigned int* indices,
+         size_t indices_count,
+         std::vector<Texture> textures,
+         const BoundingBox& bounds,
+         VertexFormat format = VertexFormat::kFloat) noexcept :
+         _range({ 0, 0, indices_count, IndexType(vertices_count) }),
          _textures(textures),
+         _bounds(bounds),
+         _transform(1.0f),
+         _vertex_buffer_size(0),
+         _index_buffer_size(0),
          VAO(0),
          VBO(0),
          EBO(0) {
-        setupMesh();
+        setupSamplerSlots();
+        setupPositionTransform(format, _bounds);
+        setupMesh(vertices, vertices_count, indices, format);
     }
 
-    void Draw(const Shader& shader) const {
-        unsigned int diffuse_counter = 1;
-        unsigned int specular_counter = 1;
+    // A mesh living in buffers shared with others. It owns no GL object
+    // and Draw expects the VAO of the buffers to be bound. Quantized
+    // positions are relative to quantization_bounds instead of bounds.
+    Mesh(const MeshRange& range,
+         std::vector<Texture> textures,
+         const BoundingBox& bounds,
+         VertexFormat format,
+         const BoundingBox& quantization_bounds) noexcept :
+         _range(range),
+         _textures(textures),
+         _bounds(bounds),
+         _transform(1.0f),
+         _vertex_buffer_size(0),
+         _index_buffer_size(0),
+         VAO(0),
+         VBO(0),
+         EBO(0) {
+        setupSamplerSlots();
+        setupPositionTransform(format, quantization_bounds);
+    }
 
-        for (size_t i = 0; i < _textures.size(); i++) {
-            const auto& texture = _textures[i];
+    inline const BoundingBox& bounds() const {
+        return _bounds;
+    }
 
-            glActiveTexture(GL_TEXTURE0 + i);
+    inline size_t vertexBufferSize() const {
+        return _vertex_buffer_size;
+    }
 
-            std::string shaderVariableName;
-            if (texture.type == "texture_diffuse") {
-                shaderVariableName = texture.type + std::to_string(diffuse_counter);
-                diffuse_counter += 1;
-            } else if (texture.type == "texture_specular") {
-                shaderVariableName = texture.type + std::to_string(specular_counter);
-                specular_counter += 1;
-            }
+    inline size_t indexBufferSize() const {
+        return _index_buffer_size;
+    }
+
+    inline const MeshRange& range() const {
+        return _range;
+    }
+
+    inline const std::vector<Texture>& textures() const {
+        return _textures;
+    }
+
+    // Sampler slot of each texture, see kSamplerSlots.
+    inline const std::vector<uint8_t>& samplerSlots() const {
+        return _sampler_slots;
+    }
 
-            shader.setInt(shaderVariableName, i);
-            glBindTexture(GL_TEXTURE_2D, texture.id);
+    inline const glm::vec3& positionScale() const {
+        return _position_scale;
+    }
+
+    inline const glm::vec3& positionOffset() const {
+        return _position_offset;
+    }
+
+    // Transform of the node the mesh hangs from, see kNodeTransformAttribute.
+    inline const glm::mat4& transform() const {
+        return _transform;
+    }
+
+    void SetTransform(const glm::mat4& transform) {
+        _transform = transform;
+    }
+
+    // The VAO the mesh owns, 0 when it lives in shared buffers.
+    inline unsigned int vao() const {
+        return VAO;
+    }
+
+    // Sets the uniforms and binds the textures of the mesh, everything Draw
+    // does but the draw call. Bindless textures are set on their sampler
+    // and take no unit, shader has to declare it layout(bindless_sampler)
+    // (see shader_array_bindless.fs). uniforms have to be resolved from
+    // shader.
+    void Bind(const Shader& shader, const MeshUniforms& uniforms) const {
+        shader.set(uniforms.position_scale, _position_scale);
+        shader.set(uniforms.position_offset, _position_offset);
+
+        for (size_t i = 0; i < _textures.size(); i++) {
+            int location = _sampler_slots[i] == kNoSamplerSlot
+                ? -1 : uniforms.samplers[_sampler_slots[i]];
+#ifdef GL_ARB_bindless_texture
+            if (_textures[i].handle) {
+                if (location >= 0) {
+                    glUniformHandleui64ARB(location, _textures[i].handle);
+                }
+                continue;
+            }
+#endif
+            glActiveTexture(GL_TEXTURE0 + i);
+            shader.setInt(location, i);
+            glBindTexture(_textures[i].target, _textures[i].id);
         }
 
         glActiveTexture(GL_TEXTURE0);
+        BindLayers();
+        BindTransform();
+    }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, _indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // Sets the layers of the textures, see kMaterialLayersAttribute.
+    void BindLayers() const {
+        GLint layers[kMaxMaterialLayers] = {};
+        for (size_t i = 0; i < _textures.size() && i < kMaxMaterialLayers; i++) {
+            layers[i] = _textures[i].layer;
+        }
+        glVertexAttribI4i(kMaterialLayersAttribute, layers[0], layers[1], layers[2], layers[3]);
+    }
+
+    // Sets the node transform, see kNodeTransformAttribute.
+    void BindTransform() const {
+        for (GLuint i = 0; i < 4; i++) {
+            glVertexAttrib4fv(kNodeTransformAttribute + i, &_transform[i][0]);
+        }
+    }
+
+    // Switches the textures found in arrays to their layer. Expects a shader
+    // sampling them as sampler2DArray, see shader_array.fs.
+    void PackTextures(const TextureArrays& arrays) {
+        for (auto& texture: _textures) {
+            if (const TextureArrays::Layer* layer = arrays.Find(texture.id)) {
+                texture.id = layer->array;
+                texture.target = GL_TEXTURE_2D_ARRAY;
+                texture.layer = layer->layer;
+                texture.handle = layer->handle;
+            }
+        }
+    }
+
+    void Draw(const Shader& shader, const MeshUniforms& uniforms) const {
+        Bind(shader, uniforms);
+
+        if (VAO) {
+            glBindVertexArray(VAO);
+        }
+        DrawRange();
+        if (VAO) {
+            glBindVertexArray(0);
+        }
+    }
+
+    // Only the draw call, with whatever VAO, textures and uniforms are bound.
+    void DrawRange() const {
+        glDrawElementsBaseVertex(GL_TRIANGLES, _range.indices_count, _range.index_type,
+            reinterpret_cast<void*>(_range.index_offset), _range.base_vertex);
     }
 
 private:
-    std::vector<Vertex> _vertices;
-    std::vector<unsigned int> _indices;
+    MeshRange _range;
     std::vector<Texture> _textures;
+    // Sampler slot (see SamplerName) per texture unit, kNoSamplerSlot when
+    // the shader has no uniform for it. Built once so that Draw does not
+    // assemble strings every frame.
+    std::vector<uint8_t> _sampler_slots;
+    BoundingBox _bounds;
+    glm::mat4 _transform;
+    // Maps the (possibly quantized) attribute back to model space.
+    glm::vec3 _position_scale;
+    glm::vec3 _position_offset;
+    // Only counted for the buffers the mesh owns.
+    size_t _vertex_buffer_size;
+    size_t _index_buffer_size;
 
     unsigned int VAO;
     unsigned int VBO;
     unsigned int EBO;
 
-    void setupMesh() {
+    void setupSamplerSlots() {
+        unsigned int diffuse_counter = 1;
+        unsigned int specular_counter = 1;
+
+        _sampler_slots.reserve(_textures.size());
+        for (const auto& texture: _textures) {
+            uint8_t slot = kNoSamplerSlot;
+            if (texture.type == "texture_diffuse") {
+                if (diffuse_counter <= kSamplersPerType) {
+                    slot = static_cast<uint8_t>(diffuse_counter - 1);
+                }
+                diffuse_counter += 1;
+            } else if (texture.type == "texture_specular") {
+                if (specular_counter <= kSamplersPerType) {
+                    slot = static_cast<uint8_t>(kSamplersPerType + specular_counter - 1);
+                }
+                specular_counter += 1;
+            }
+            _sampler_slots.push_back(slot);
+        }
+    }
+
+    void setupPositionTransform(VertexFormat format, const BoundingBox& quantization_bounds) {
+        if (format == VertexFormat::kQuantized) {
+            _position_scale = quantization_bounds.max - quantization_bounds.min;
+            _position_offset = quantization_bounds.min;
+        } else {
+            _position_scale = glm::vec3(1.0f);
+            _position_offset = glm::vec3(0.0f);
+        }
+    }
+
+    void setupMesh(const Vertex* vertices,
+                   size_t vertices_count,
+                   const unsigned int* indices,
+                   VertexFormat format) {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
@@ -81,24 +355,16 @@ private:
         glBindVertexArray(VAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, _vertices.size() * sizeof(Vertex),
-            &_vertices[0], GL_STATIC_DRAW);
+        _vertex_buffer_size = vertices_count * VertexSize(format);
+        glBufferData(GL_ARRAY_BUFFER, _vertex_buffer_size, nullptr, GL_STATIC_DRAW);
+        UploadVertices(0, format, vertices, vertices_count, _bounds.min, _bounds.max);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(unsigned int),
-            &_indices[0], GL_STATIC_DRAW);
-
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-            reinterpret_cast<void*>(0));
-
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-            reinterpret_cast<void*>(offsetof(Vertex, Normal)));
+        _index_buffer_size = _range.indices_count * IndexSize(_range.index_type);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _index_buffer_size, nullptr, GL_STATIC_DRAW);
+        UploadIndices(0, _range.index_type, indices, _range.indices_count);
 
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-            reinterpret_cast<void*>(offsetof(Vertex, TexCoords)));
+        SetupVertexAttributes(format);
 
         glBindVertexArray(0);
     }
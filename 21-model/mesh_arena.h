@@ -0,0 +1,130 @@
+#ifndef __MESH_ARENA_H__
+#define __MESH_ARENA_H__
+
+#include <limits>
+#include <vector>
+
+#include <glad.h>
+
+#include "mesh.h"
+#include "vertex_format.h"
+
+// One VAO, VBO and EBO holding every mesh of a model back to back. Each
+// mesh keeps its own indices (relative to its first vertex) and is drawn
+// with glDrawElementsBaseVertex from its range, so drawing the whole model
+// binds a single VAO.
+//
+// The index type is shared: 16 bits if every mesh has at most 65536
+// vertices, 32 otherwise. kQuantized positions are quantized within the
+// bounds of the whole arena, so that every mesh maps them back the same
+// way and consecutive meshes can be drawn with a single call.
+class MeshArena {
+public:
+    // Vertices and indices are only read during construction.
+    struct Source {
+        const Vertex* vertices;
+        size_t vertices_count;
+        const unsigned int* indices;
+        size_t indices_count;
+        BoundingBox bounds;
+        BoundingSphere sphere;
+    };
+
+    MeshArena(const std::vector<Source>& sources, VertexFormat format) noexcept
+        : _index_type(GL_UNSIGNED_SHORT), VAO(0), VBO(0), EBO(0) {
+        size_t vertices_count = 0;
+        size_t indices_count = 0;
+        _bounds.min = glm::vec3(std::numeric_limits<float>::max());
+        _bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+        for (const auto& source: sources) {
+            _bounds.min = glm::min(_bounds.min, source.bounds.min);
+            _bounds.max = glm::max(_bounds.max, source.bounds.max);
+            vertices_count += source.vertices_count;
+            indices_count += source.indices_count;
+            if (IndexType(source.vertices_count) == GL_UNSIGNED_INT) {
+                _index_type = GL_UNSIGNED_INT;
+            }
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        _vertex_buffer_size = vertices_count * VertexSize(format);
+        glBufferData(GL_ARRAY_BUFFER, _vertex_buffer_size, nullptr, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        _index_buffer_size = indices_count * IndexSize(_index_type);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _index_buffer_size, nullptr, GL_STATIC_DRAW);
+
+        size_t first_vertex = 0;
+        size_t first_index = 0;
+        _ranges.reserve(sources.size());
+        for (const auto& source: sources) {
+            UploadVertices(first_vertex * VertexSize(format), format,
+                source.vertices, source.vertices_count, _bounds.min, _bounds.max);
+            UploadIndices(first_index * IndexSize(_index_type), _index_type,
+                source.indices, source.indices_count);
+
+            _ranges.push_back({ static_cast<GLint>(first_vertex),
+                first_index * IndexSize(_index_type), source.indices_count, _index_type });
+            first_vertex += source.vertices_count;
+            first_index += source.indices_count;
+        }
+
+        SetupVertexAttributes(format);
+
+        glBindVertexArray(0);
+    }
+
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    ~MeshArena() {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    // Same order as the sources.
+    inline const std::vector<MeshRange>& ranges() const {
+        return _ranges;
+    }
+
+    // Union of the bounds of all meshes.
+    inline const BoundingBox& bounds() const {
+        return _bounds;
+    }
+
+    inline size_t vertexBufferSize() const {
+        return _vertex_buffer_size;
+    }
+
+    inline size_t indexBufferSize() const {
+        return _index_buffer_size;
+    }
+
+    void Bind() const {
+        glBindVertexArray(VAO);
+    }
+
+    inline unsigned int vao() const {
+        return VAO;
+    }
+
+private:
+    std::vector<MeshRange> _ranges;
+    BoundingBox _bounds;
+    GLenum _index_type;
+    size_t _vertex_buffer_size;
+    size_t _index_buffer_size;
+
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int EBO;
+};
+
+#endif  // __MESH_ARENA_H__
@@ -0,0 +1,430 @@
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mesh.h"
+#include "scene_graph.h"
+
+// Binary cache of an imported model, written next to the source file
+// ("backpack.obj" -> "backpack.obj.meshcache") after the first import.
+//
+// Layout, all offsets from the beginning of the file:
+//
+//   MeshCacheHeader
+//   MeshCacheRecord[meshes_count]
+//   MeshCacheTexture[textures_count]
+//   MeshCacheNode[nodes_count] (the scene graph, depth first)
+//   strings (texture types and paths, not zero terminated)
+//   per mesh: Vertex[vertices_count], unsigned int[indices_count]
+//
+// Vertex and index arrays are 8 byte aligned, so a mapped file can be
+// handed to glBufferData as is. The cache is keyed to the source by its
+// size and modification time; when only the time differs (e.g. after a
+// fresh checkout) the content hash decides, and a match records the new
+// time so that the next launch does not hash again.
+class MeshCache {
+public:
+    struct Entry {
+        const Vertex* vertices;
+        size_t vertices_count;
+        const unsigned int* indices;
+        size_t indices_count;
+        std::vector<TextureRef> textures;
+        BoundingBox bounds;
+        BoundingSphere sphere;
+        uint32_t node;
+    };
+
+    MeshCache() noexcept : _data(nullptr), _size(0) {}
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    ~MeshCache() {
+        if (_data) {
+            munmap(_data, _size);
+        }
+    }
+
+    // Maps the cache file and validates it against the source. The entries
+    // point into the mapping and stay valid as long as this object lives.
+    bool Open(const std::string& cache_path, const std::string& source_path) {
+        int fd = open(cache_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 ||
+            static_cast<size_t>(file_stat.st_size) < sizeof(MeshCacheHeader)) {
+            close(fd);
+            return false;
+        }
+
+        _size = file_stat.st_size;
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            _size = 0;
+            return false;
+        }
+        _data = static_cast<char*>(data);
+
+        if (!ReadEntries(cache_path, source_path)) {
+            std::cout << "[MESH CACHE] " << cache_path << " is stale or corrupted" << std::endl;
+            munmap(_data, _size);
+            _data = nullptr;
+            _size = 0;
+            _entries.clear();
+            _nodes.clear();
+            return false;
+        }
+        return true;
+    }
+
+    inline const std::vector<Entry>& entries() const {
+        return _entries;
+    }
+
+    inline const std::vector<SceneNode>& nodes() const {
+        return _nodes;
+    }
+
+    static bool Write(const std::string& cache_path,
+                      const std::string& source_path,
+                      const std::vector<MeshData>& meshes,
+                      const std::vector<SceneNode>& nodes) {
+        SourceStamp stamp;
+        if (!ReadStamp(source_path, stamp) || !HashFile(source_path, stamp.hash)) {
+            return false;
+        }
+
+        std::vector<MeshCacheRecord> records(meshes.size());
+        std::vector<MeshCacheTexture> textures;
+        std::string strings;
+
+        uint64_t offset = sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheRecord);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const auto& mesh = meshes[i];
+            auto& record = records[i];
+
+            record.first_texture = textures.size();
+            record.textures_count = mesh.textures.size();
+            for (const auto& texture: mesh.textures) {
+                MeshCacheTexture entry;
+                entry.type_offset = strings.size();
+                entry.type_length = texture.type.size();
+                strings += texture.type;
+                entry.path_offset = strings.size();
+                entry.path_length = texture.path.size();
+                strings += texture.path;
+                textures.push_back(entry);
+            }
+
+            record.vertices_count = mesh.vertices.size();
+            record.indices_count = mesh.indices.size();
+            std::memcpy(record.bounds_min, &mesh.bounds.min, sizeof(record.bounds_min));
+            std::memcpy(record.bounds_max, &mesh.bounds.max, sizeof(record.bounds_max));
+            std::memcpy(record.sphere_center, &mesh.sphere.center, sizeof(record.sphere_center));
+            record.sphere_radius = mesh.sphere.radius;
+            record.node = mesh.node;
+        }
+
+        std::vector<MeshCacheNode> cache_nodes(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++) {
+            cache_nodes[i].parent = nodes[i].parent;
+            std::memcpy(cache_nodes[i].local, &nodes[i].local[0][0], sizeof(cache_nodes[i].local));
+        }
+
+        offset += textures.size() * sizeof(MeshCacheTexture);
+        offset += cache_nodes.size() * sizeof(MeshCacheNode);
+        uint64_t strings_offset = offset;
+        offset += strings.size();
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            auto& record = records[i];
+            offset = Align(offset);
+            record.vertices_offset = offset;
+            offset += record.vertices_count * sizeof(Vertex);
+            offset = Align(offset);
+            record.indices_offset = offset;
+            offset += record.indices_count * sizeof(unsigned int);
+        }
+
+        MeshCacheHeader header;
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.vertex_size = sizeof(Vertex);
+        header.index_size = sizeof(unsigned int);
+        header.source_size = stamp.size;
+        header.source_mtime = stamp.mtime;
+        header.source_hash = stamp.hash;
+        header.meshes_count = records.size();
+        header.textures_count = textures.size();
+        header.nodes_count = cache_nodes.size();
+        header.padding = 0;
+        header.strings_offset = strings_offset;
+        header.strings_size = strings.size();
+
+        // Written under a temporary name and renamed, so a crash midway never
+        // leaves a truncated cache behind.
+        std::string temporary_path = cache_path + ".tmp";
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        uint64_t written = 0;
+        auto write = [&](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), size);
+            written += size;
+        };
+        auto pad = [&]() {
+            static const char kZeros[kAlignment] = {};
+            write(kZeros, Align(written) - written);
+        };
+
+        write(&header, sizeof(header));
+        write(records.data(), records.size() * sizeof(MeshCacheRecord));
+        write(textures.data(), textures.size() * sizeof(MeshCacheTexture));
+        write(cache_nodes.data(), cache_nodes.size() * sizeof(MeshCacheNode));
+        write(strings.data(), strings.size());
+        for (const auto& mesh: meshes) {
+            pad();
+            write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            pad();
+            write(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+
+        file.close();
+        if (!file) {
+            std::filesystem::remove(temporary_path);
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary_path, cache_path, error);
+        return !error;
+    }
+
+private:
+    static constexpr char kMagic[4] = { 'L', 'O', 'M', 'C' };
+    // Bump on any change of the layout, Vertex included, or of what the
+    // importer produces (2: vertex cache optimized meshes, 3: bounding
+    // spheres, 4: scene graph).
+    static constexpr uint32_t kVersion = 4;
+    static constexpr uint64_t kAlignment = 8;
+
+    struct MeshCacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertex_size;
+        uint32_t index_size;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t source_hash;
+        uint32_t meshes_count;
+        uint32_t textures_count;
+        uint32_t nodes_count;
+        uint32_t padding;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    struct MeshCacheRecord {
+        uint64_t vertices_offset;
+        uint64_t indices_offset;
+        uint32_t vertices_count;
+        uint32_t indices_count;
+        uint32_t first_texture;
+        uint32_t textures_count;
+        float bounds_min[3];
+        float bounds_max[3];
+        float sphere_center[3];
+        float sphere_radius;
+        uint32_t node;
+        uint32_t padding;
+    };
+
+    struct MeshCacheNode {
+        int32_t parent;
+        float local[16];
+    };
+
+    struct MeshCacheTexture {
+        uint32_t type_offset;
+        uint32_t type_length;
+        uint32_t path_offset;
+        uint32_t path_length;
+    };
+
+    struct SourceStamp {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash;
+    };
+
+    char* _data;
+    size_t _size;
+    std::vector<Entry> _entries;
+    std::vector<SceneNode> _nodes;
+
+    static uint64_t Align(uint64_t offset) {
+        return (offset + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    static bool ReadStamp(const std::string& path, SourceStamp& stamp) {
+        std::error_code error;
+        stamp.size = std::filesystem::file_size(path, error);
+        if (error) {
+            return false;
+        }
+        stamp.mtime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        stamp.hash = 0;
+        return !error;
+    }
+
+    // FNV-1a over the whole file.
+    static bool HashFile(const std::string& path, uint64_t& hash) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        hash = 14695981039346656037ull;
+        char buffer[64 * 1024];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+            for (std::streamsize i = 0; i < file.gcount(); i++) {
+                hash ^= static_cast<unsigned char>(buffer[i]);
+                hash *= 1099511628211ull;
+            }
+        }
+        return true;
+    }
+
+    bool InBounds(uint64_t offset, uint64_t size) const {
+        return offset <= _size && size <= _size - offset;
+    }
+
+    // Rewrites source_mtime in place. Failing (e.g. a read only directory)
+    // only means the next launch hashes the source again. The mapping is
+    // private and source_mtime is not read from it after validation.
+    static void WriteSourceMtime(const std::string& cache_path, int64_t mtime) {
+        int fd = open(cache_path.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return;
+        }
+        ssize_t written = pwrite(fd, &mtime, sizeof(mtime), offsetof(MeshCacheHeader, source_mtime));
+        close(fd);
+        if (written != static_cast<ssize_t>(sizeof(mtime))) {
+            std::cout << "[MESH CACHE] Failed to update the source time of " << cache_path << std::endl;
+        }
+    }
+
+    bool ReadEntries(const std::string& cache_path, const std::string& source_path) {
+        MeshCacheHeader header;
+        std::memcpy(&header, _data, sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+            header.version != kVersion ||
+            header.vertex_size != sizeof(Vertex) ||
+            header.index_size != sizeof(unsigned int)) {
+            return false;
+        }
+
+        SourceStamp stamp;
+        if (!ReadStamp(source_path, stamp) || stamp.size != header.source_size) {
+            return false;
+        }
+        // Touched, e.g. by a checkout: only a different content is stale.
+        bool touched = stamp.mtime != header.source_mtime;
+        if (touched &&
+            (!HashFile(source_path, stamp.hash) || stamp.hash != header.source_hash)) {
+            return false;
+        }
+
+        uint64_t records_offset = sizeof(MeshCacheHeader);
+        uint64_t textures_offset = records_offset +
+            uint64_t(header.meshes_count) * sizeof(MeshCacheRecord);
+        uint64_t nodes_offset = textures_offset +
+            uint64_t(header.textures_count) * sizeof(MeshCacheTexture);
+        if (!InBounds(records_offset, uint64_t(header.meshes_count) * sizeof(MeshCacheRecord)) ||
+            !InBounds(textures_offset, uint64_t(header.textures_count) * sizeof(MeshCacheTexture)) ||
+            !InBounds(nodes_offset, uint64_t(header.nodes_count) * sizeof(MeshCacheNode)) ||
+            !InBounds(header.strings_offset, header.strings_size)) {
+            return false;
+        }
+
+        _nodes.resize(header.nodes_count);
+        for (size_t i = 0; i < header.nodes_count; i++) {
+            MeshCacheNode node;
+            std::memcpy(&node, _data + nodes_offset + i * sizeof(MeshCacheNode), sizeof(node));
+            // Parents come first, see SceneGraph.
+            if (node.parent < SceneGraph::kNoParent || node.parent >= static_cast<int64_t>(i)) {
+                return false;
+            }
+            _nodes[i].parent = node.parent;
+            std::memcpy(&_nodes[i].local[0][0], node.local, sizeof(node.local));
+        }
+
+        const char* strings = _data + header.strings_offset;
+        _entries.resize(header.meshes_count);
+        for (size_t i = 0; i < header.meshes_count; i++) {
+            MeshCacheRecord record;
+            std::memcpy(&record, _data + records_offset + i * sizeof(MeshCacheRecord), sizeof(record));
+
+            if (!InBounds(record.vertices_offset, uint64_t(record.vertices_count) * sizeof(Vertex)) ||
+                !InBounds(record.indices_offset, uint64_t(record.indices_count) * sizeof(unsigned int)) ||
+                record.vertices_offset % kAlignment != 0 ||
+                record.indices_offset % kAlignment != 0 ||
+                uint64_t(record.first_texture) + record.textures_count > header.textures_count ||
+                record.node >= header.nodes_count) {
+                return false;
+            }
+
+            auto& entry = _entries[i];
+            entry.vertices = reinterpret_cast<const Vertex*>(_data + record.vertices_offset);
+            entry.vertices_count = record.vertices_count;
+            entry.indices = reinterpret_cast<const unsigned int*>(_data + record.indices_offset);
+            entry.indices_count = record.indices_count;
+            std::memcpy(&entry.bounds.min, record.bounds_min, sizeof(record.bounds_min));
+            std::memcpy(&entry.bounds.max, record.bounds_max, sizeof(record.bounds_max));
+            std::memcpy(&entry.sphere.center, record.sphere_center, sizeof(record.sphere_center));
+            entry.sphere.radius = record.sphere_radius;
+            entry.node = record.node;
+
+            for (uint32_t j = 0; j < record.textures_count; j++) {
+                MeshCacheTexture texture;
+                std::memcpy(&texture, _data + textures_offset +
+                    (record.first_texture + j) * sizeof(MeshCacheTexture), sizeof(texture));
+                if (uint64_t(texture.type_offset) + texture.type_length > header.strings_size ||
+                    uint64_t(texture.path_offset) + texture.path_length > header.strings_size) {
+                    return false;
+                }
+                entry.textures.push_back({
+                    std::string(strings + texture.type_offset, texture.type_length),
+                    std::string(strings + texture.path_offset, texture.path_length),
+                });
+            }
+        }
+
+        if (touched) {
+            WriteSourceMtime(cache_path, stamp.mtime);
+        }
+        return true;
+    }
+};
+
+#endif  // __MESH_CACHE_H__
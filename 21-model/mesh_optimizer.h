@@ -0,0 +1,220 @@
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "vertex_format.h"
+
+// Reorders triangle lists for the GPU, independent of GL so it can run on
+// the pool during import or in an offline tool:
+//
+//  - OptimizeVertexCache() reorders triangles so that consecutive ones share
+//    vertices still in the post-transform cache (Tom Forsyth, "Linear-Speed
+//    Vertex Cache Optimisation").
+//  - OptimizeVertexFetch() then renumbers vertices in the order they are
+//    first used, so vertex fetches walk memory mostly forward.
+//
+// Neither changes what is drawn, only the order.
+
+// Average cache miss ratio: vertices transformed per triangle with a FIFO
+// post-transform cache of cache_size entries. 3 is the worst case, ~0.5 the
+// best a closed mesh can get.
+inline float Acmr(const std::vector<unsigned int>& indices, size_t cache_size = 16) {
+    if (indices.size() < 3) {
+        return 0.0f;
+    }
+
+    std::vector<unsigned int> fifo(cache_size, std::numeric_limits<unsigned int>::max());
+    size_t head = 0;
+    size_t misses = 0;
+    for (unsigned int index: indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) == fifo.end()) {
+            fifo[head] = index;
+            head = (head + 1) % cache_size;
+            misses++;
+        }
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+inline void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertices_count) {
+    constexpr int kCacheSize = 32;
+    constexpr float kLastTriangleScore = 0.75f;
+    constexpr float kCacheDecayPower = 1.5f;
+    constexpr float kValenceBoostScale = 2.0f;
+    constexpr float kValenceBoostPower = -0.5f;
+
+    size_t triangles_count = indices.size() / 3;
+    if (triangles_count == 0) {
+        return;
+    }
+
+    // Triangles using each vertex, the live ones first.
+    std::vector<unsigned int> first_triangle(vertices_count + 1, 0);
+    for (unsigned int index: indices) {
+        first_triangle[index + 1]++;
+    }
+    for (size_t i = 0; i < vertices_count; i++) {
+        first_triangle[i + 1] += first_triangle[i];
+    }
+    std::vector<unsigned int> live_count(vertices_count);
+    for (size_t i = 0; i < vertices_count; i++) {
+        live_count[i] = first_triangle[i + 1] - first_triangle[i];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(first_triangle.begin(), first_triangle.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<int> cache_position(vertices_count, -1);
+    auto vertex_score = [&](unsigned int vertex) {
+        if (live_count[vertex] == 0) {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        int position = cache_position[vertex];
+        if (position >= 0 && position < 3) {
+            score = kLastTriangleScore;
+        } else if (position >= 3) {
+            float scaler = 1.0f / (kCacheSize - 3);
+            score = std::pow(1.0f - (position - 3) * scaler, kCacheDecayPower);
+        }
+        return score + kValenceBoostScale
+            * std::pow(static_cast<float>(live_count[vertex]), kValenceBoostPower);
+    };
+
+    std::vector<float> score(vertices_count);
+    for (size_t i = 0; i < vertices_count; i++) {
+        score[i] = vertex_score(i);
+    }
+    std::vector<float> triangle_score(triangles_count);
+    std::vector<bool> emitted(triangles_count, false);
+    for (size_t i = 0; i < triangles_count; i++) {
+        triangle_score[i] = score[indices[i * 3]] + score[indices[i * 3 + 1]]
+            + score[indices[i * 3 + 2]];
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> next_cache;
+    cache.reserve(kCacheSize + 3);
+    next_cache.reserve(kCacheSize + 3);
+
+    size_t cursor = 0;
+    long best = 0;
+    for (size_t i = 1; i < triangles_count; i++) {
+        if (triangle_score[i] > triangle_score[best]) {
+            best = i;
+        }
+    }
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // Nothing in the cache touches a live triangle, restart from
+            // the first one left in input order.
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const unsigned int* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        for (int i = 0; i < 3; i++) {
+            unsigned int vertex = triangle[i];
+            unsigned int* begin = &adjacency[first_triangle[vertex]];
+            unsigned int* end = begin + live_count[vertex];
+            unsigned int* it = std::find(begin, end, static_cast<unsigned int>(best));
+            std::swap(*it, *(end - 1));
+            live_count[vertex]--;
+        }
+
+        // The triangle goes to the front of the LRU cache, what falls off the
+        // end is evicted.
+        next_cache.assign(triangle, triangle + 3);
+        for (unsigned int vertex: cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                next_cache.push_back(vertex);
+            }
+        }
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            cache_position[next_cache[i]] = i < kCacheSize ? static_cast<int>(i) : -1;
+            score[next_cache[i]] = vertex_score(next_cache[i]);
+        }
+        if (next_cache.size() > kCacheSize) {
+            next_cache.resize(kCacheSize);
+        }
+        std::swap(cache, next_cache);
+
+        best = -1;
+        float best_score = -1.0f;
+        for (unsigned int vertex: cache) {
+            const unsigned int* begin = &adjacency[first_triangle[vertex]];
+            for (unsigned int j = 0; j < live_count[vertex]; j++) {
+                unsigned int candidate = begin[j];
+                float candidate_score = score[indices[candidate * 3]]
+                    + score[indices[candidate * 3 + 1]] + score[indices[candidate * 3 + 2]];
+                if (candidate_score > best_score) {
+                    best_score = candidate_score;
+                    best = candidate;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+// Vertices no triangle references are kept, after the used ones.
+inline void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    constexpr unsigned int kUnassigned = std::numeric_limits<unsigned int>::max();
+
+    std::vector<unsigned int> remap(vertices.size(), kUnassigned);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int& index: indices) {
+        if (remap[index] == kUnassigned) {
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] == kUnassigned) {
+            reordered.push_back(vertices[i]);
+        }
+    }
+    vertices.swap(reordered);
+}
+
+struct MeshOptimizationReport {
+    float acmr_before;
+    float acmr_after;
+};
+
+// Both passes, in order. Only meant for triangle lists.
+inline MeshOptimizationReport OptimizeMesh(std::vector<Vertex>& vertices,
+                                           std::vector<unsigned int>& indices) {
+    MeshOptimizationReport report;
+    report.acmr_before = Acmr(indices);
+    if (indices.size() % 3 != 0) {
+        report.acmr_after = report.acmr_before;
+        return report;
+    }
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeVertexFetch(vertices, indices);
+    report.acmr_after = Acmr(indices);
+    return report;
+}
+
+#endif  // __MESH_OPTIMIZER_H__
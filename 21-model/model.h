@@ -1,8 +1,12 @@
 #ifndef __MODEL_H__
 #define __MODEL_H__
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <limits>
+#include <memory>
 #include <iostream>
 #include <unordered_map>
 
@@ -10,67 +14,240 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "bounds.h"
+#include "draw_batches.h"
+#include "frustum.h"
 #include "mesh.h"
+#include "mesh_arena.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "render_queue.h"
+#include "scene_graph.h"
 #include "shader.h"
+#include "texture_array.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+// How the meshes of a Model are stored on the GPU.
+enum class MeshLayout {
+    kSeparate,  // a VAO, VBO and EBO per mesh
+    kArena,     // all meshes in one MeshArena, a single VAO bind per Draw
+                // and one draw call per material with DrawBatched
+};
 
-namespace {
+class Model {
+public:
+    // format selects the vertex layout of every mesh, see vertex_format.h.
+    Model(const std::string& path,
+          VertexFormat format = VertexFormat::kFloat,
+          MeshLayout layout = MeshLayout::kSeparate)
+        : _visible_meshes(0), _vertex_format(format), _layout(layout), _draw_calls(0),
+          _uniforms_program(0) {
+        loadModel(path);
+    }
 
-unsigned int BindTexture(const std::string& path) {
-    int width, height, nrChannels;
-    unsigned char* texture_data =
-        stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (!texture_data) {
-        std::cout << "Error while loading texture" << std::endl;
-        std::abort();
-        return -1;
+    // Uploads textures decoded in the background, spending at most budget
+    // on it. Meant to be called once per frame; returns true once all
+    // textures (of every model, they share the TextureCache) are uploaded.
+    bool UploadTextures(std::chrono::microseconds budget) {
+        return TextureCache::Shared().Upload(budget) == 0;
     }
 
-    GLenum format;
-    if (nrChannels == 1) {
-        format = GL_RED;
-    } else if (nrChannels == 3) {
-        format = GL_RGB;
-    } else if (nrChannels == 4) {
-        format = GL_RGBA;
+    // Copies the material textures into TextureArrays, waiting for the ones
+    // still loading, and draws the meshes from the arrays from then on with
+    // a shader sampling sampler2DArray (shader_array.fs). The 2D textures
+    // are released, unless another model shares them. Returns the number
+    // of arrays.
+    size_t PackTextures() {
+        if (_texture_arrays) {
+            return _texture_arrays->size();
+        }
+        TextureCache::Shared().Finish();
+
+        std::vector<unsigned int> textures;
+        for (const auto& mesh: _meshes) {
+            for (const auto& texture: mesh.textures()) {
+                textures.push_back(texture.id);
+            }
+        }
+        _texture_arrays = std::make_unique<TextureArrays>(textures);
+        for (auto& mesh: _meshes) {
+            mesh.PackTextures(*_texture_arrays);
+        }
+        if (_arena) {
+            _batches = std::make_unique<DrawBatches>(_meshes, _mesh_nodes, _arena->vao());
+        }
+
+        _textures_lookup.clear();
+        _texture_handles.clear();
+        return _texture_arrays->size();
     }
 
-    unsigned int texture;
-    glGenTextures(1, &texture);
+    // Null until PackTextures.
+    inline const TextureArrays* textureArrays() const {
+        return _texture_arrays.get();
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    size_t vertexBufferSize() const {
+        size_t size = _arena ? _arena->vertexBufferSize() : 0;
+        for (const auto& mesh: _meshes) {
+            size += mesh.vertexBufferSize();
+        }
+        return size;
+    }
 
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
-        format, GL_UNSIGNED_BYTE, texture_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    size_t indexBufferSize() const {
+        size_t size = _arena ? _arena->indexBufferSize() : 0;
+        for (const auto& mesh: _meshes) {
+            size += mesh.indexBufferSize();
+        }
+        return size;
+    }
 
-    stbi_image_free(texture_data);
-    return texture;
-}
+    // The node hierarchy of the model, meshes hang from its nodes.
+    inline const SceneGraph& scene() const {
+        return _scene;
+    }
 
-}  // namespace
+    // Moves node and everything below it, e.g. to animate a part of the
+    // model. The world transforms are only recomputed, for the subtrees
+    // that changed, by the next Cull or draw.
+    void SetNodeTransform(uint32_t node, const glm::mat4& local) {
+        _scene.SetLocal(node, local);
+    }
 
-class Model {
-public:
-    Model(const std::string& path) {
-        loadModel(path);
+    // Marks the meshes entirely outside frustum as culled, Draw,
+    // DrawBatched and Enqueue leave them out until the next Cull. The
+    // bounds are in model space, so frustum has to be built from
+    // projection * view * model. Returns the number of visible meshes.
+    size_t Cull(const Frustum& frustum) {
+        UpdateTransforms();
+        _visible_meshes = frustum.Cull(_boxes.data(), _spheres.data(),
+            _meshes.size(), _visible.data());
+        return _visible_meshes;
+    }
+
+    // Draws every mesh again.
+    void ResetCulling() {
+        std::fill(_visible.begin(), _visible.end(), 1);
+        _visible_meshes = _meshes.size();
+    }
+
+    inline size_t visibleMeshes() const {
+        return _visible_meshes;
+    }
+
+    inline size_t culledMeshes() const {
+        return _meshes.size() - _visible_meshes;
     }
 
     void Draw(const Shader& shader) {
-        for (const auto& mesh: _meshes) {
-            mesh.Draw(shader);
+        UpdateTransforms();
+        const MeshUniforms& uniforms = meshUniforms(shader);
+        if (_arena) {
+            _arena->Bind();
+        }
+        for (size_t i = 0; i < _meshes.size(); i++) {
+            if (_visible[i]) {
+                _meshes[i].Draw(shader, uniforms);
+            }
+        }
+        if (_arena) {
+            glBindVertexArray(0);
+        }
+        _draw_calls = _visible_meshes;
+    }
+
+    // Draws the meshes grouped by material, see DrawBatches. Only the arena
+    // layout can batch, the separate one falls back to Draw.
+    void DrawBatched(const Shader& shader) {
+        if (!_batches) {
+            Draw(shader);
+            return;
+        }
+        UpdateTransforms();
+        _arena->Bind();
+        _draw_calls = _batches->Draw(shader, meshUniforms(shader), _meshes, &_visible);
+        glBindVertexArray(0);
+    }
+
+    // Submits every mesh to queue instead of drawing it, depth in [0, 1].
+    void Enqueue(RenderQueue& queue, Shader& shader, float depth) {
+        UpdateTransforms();
+        for (size_t i = 0; i < _meshes.size(); i++) {
+            if (_visible[i]) {
+                const Mesh& mesh = _meshes[i];
+                queue.Submit(shader, mesh, _arena ? _arena->vao() : mesh.vao(), depth);
+            }
         }
     }
 
+    // Draw calls issued by the last Draw or DrawBatched.
+    inline size_t drawCalls() const {
+        return _draw_calls;
+    }
+
+    inline bool drawsIndirect() const {
+        return _batches && _batches->indirect();
+    }
+
 private:
     std::vector<Mesh> _meshes;
+    SceneGraph _scene;
+    // Node of every mesh.
+    std::vector<uint32_t> _mesh_nodes;
+    // Bounds of _meshes in their own space, then transformed by their node
+    // to model space, and whether the last Cull kept them.
+    std::vector<BoundingBox> _local_boxes;
+    std::vector<BoundingSphere> _local_spheres;
+    std::vector<BoundingBox> _boxes;
+    std::vector<BoundingSphere> _spheres;
+    std::vector<uint8_t> _visible;
+    size_t _visible_meshes;
+    VertexFormat _vertex_format;
+    MeshLayout _layout;
+    // Buffers of all meshes and their batches with MeshLayout::kArena.
+    std::unique_ptr<MeshArena> _arena;
+    std::unique_ptr<DrawBatches> _batches;
+    size_t _draw_calls;
+    // Resolved for the program last drawn with.
+    unsigned int _uniforms_program;
+    MeshUniforms _uniforms;
     std::string _directory;
     std::unordered_map<std::string, Texture> _textures_lookup;
+    // Keeps the textures of the meshes alive in the TextureCache.
+    std::vector<TextureCache::Handle> _texture_handles;
+    // Replaces them after PackTextures.
+    std::unique_ptr<TextureArrays> _texture_arrays;
+
+    const MeshUniforms& meshUniforms(const Shader& shader) {
+        if (shader.ID != _uniforms_program) {
+            _uniforms = MeshUniforms::Resolve(shader);
+            _uniforms_program = shader.ID;
+        }
+        return _uniforms;
+    }
 
     void loadModel(const std::string& path) {
+        _directory = path.substr(0, path.find_last_of('/'));
+
+        // Warm loads skip Assimp and upload straight from the mapped cache.
+        std::string cache_path = path + ".meshcache";
+        MeshCache cache;
+        if (cache.Open(cache_path, path)) {
+            std::vector<MeshArena::Source> sources;
+            std::vector<const std::vector<TextureRef>*> textures;
+            std::vector<uint32_t> mesh_nodes;
+            for (const auto& entry: cache.entries()) {
+                sources.push_back({ entry.vertices, entry.vertices_count,
+                    entry.indices, entry.indices_count, entry.bounds, entry.sphere });
+                textures.push_back(&entry.textures);
+                mesh_nodes.push_back(entry.node);
+            }
+            createMeshes(sources, textures, mesh_nodes, cache.nodes());
+            return;
+        }
+
         Assimp::Importer import;
         const aiScene* scene = import.ReadFile(path,
             aiProcess_Triangulate);
@@ -82,33 +259,170 @@ private:
             return;
         }
 
-        _directory = path.substr(0, path.find_last_of('/'));
-        processNode(scene->mRootNode, scene);
+        std::vector<aiMesh*> scene_meshes;
+        std::vector<uint32_t> mesh_nodes;
+        std::vector<SceneNode> nodes;
+        collectNodes(scene->mRootNode, SceneGraph::kNoParent, scene,
+            scene_meshes, mesh_nodes, nodes);
+
+        // Every aiMesh is converted on the pool, the GL objects are created
+        // below, on this thread, once all of them are done.
+        // Meshes are optimized for the vertex cache there too, the result
+        // is what the mesh cache stores.
+        std::vector<MeshData> meshes(scene_meshes.size());
+        std::vector<MeshOptimizationReport> reports(scene_meshes.size());
+        std::vector<std::future<void>> tasks;
+        tasks.reserve(scene_meshes.size());
+        for (size_t i = 0; i < scene_meshes.size(); i++) {
+            tasks.push_back(ThreadPool::Shared().Submit([&, i]() {
+                meshes[i] = processMesh(scene_meshes[i], scene);
+                meshes[i].node = mesh_nodes[i];
+                reports[i] = OptimizeMesh(meshes[i].vertices, meshes[i].indices);
+            }));
+        }
+
+        // Start decoding every material texture while the meshes convert.
+        for (size_t i = 0; i < scene->mNumMaterials; i++) {
+            loadTextures(materialTextures(scene->mMaterials[i],
+                aiTextureType_DIFFUSE, "texture_diffuse"));
+            loadTextures(materialTextures(scene->mMaterials[i],
+                aiTextureType_SPECULAR, "texture_specular"));
+        }
+
+        for (auto& task: tasks) {
+            task.get();
+        }
+
+        for (size_t i = 0; i < reports.size(); i++) {
+            std::cout << "[MESH] " << i << ": " << meshes[i].indices.size() / 3
+                      << " triangles, ACMR " << reports[i].acmr_before
+                      << " -> " << reports[i].acmr_after << std::endl;
+        }
+
+        if (!MeshCache::Write(cache_path, path, meshes, nodes)) {
+            std::cout << "[MESH CACHE] Failed to write " << cache_path << std::endl;
+        }
+
+        std::vector<MeshArena::Source> sources;
+        std::vector<const std::vector<TextureRef>*> textures;
+        for (const auto& data: meshes) {
+            sources.push_back({ data.vertices.data(), data.vertices.size(),
+                data.indices.data(), data.indices.size(), data.bounds, data.sphere });
+            textures.push_back(&data.textures);
+        }
+        createMeshes(sources, textures, mesh_nodes, nodes);
+    }
+
+    // Uploads the meshes according to the layout, textures[i] are the
+    // textures of sources[i] and mesh_nodes[i] its node in nodes.
+    void createMeshes(const std::vector<MeshArena::Source>& sources,
+                      const std::vector<const std::vector<TextureRef>*>& textures,
+                      const std::vector<uint32_t>& mesh_nodes,
+                      const std::vector<SceneNode>& nodes) {
+        _scene = SceneGraph(nodes);
+        _mesh_nodes = mesh_nodes;
+        for (const auto& source: sources) {
+            _local_boxes.push_back(source.bounds);
+            _local_spheres.push_back(source.sphere);
+        }
+        _boxes.resize(sources.size());
+        _spheres.resize(sources.size());
+        _visible.assign(sources.size(), 1);
+        _visible_meshes = sources.size();
+
+        _meshes.reserve(sources.size());
+        if (_layout == MeshLayout::kArena) {
+            _arena = std::make_unique<MeshArena>(sources, _vertex_format);
+            for (size_t i = 0; i < sources.size(); i++) {
+                _meshes.emplace_back(_arena->ranges()[i], loadTextures(*textures[i]),
+                    sources[i].bounds, _vertex_format, _arena->bounds());
+            }
+            // Before the batches, which upload the node transforms.
+            ApplyTransforms();
+            _batches = std::make_unique<DrawBatches>(_meshes, _mesh_nodes, _arena->vao());
+            return;
+        }
+
+        for (size_t i = 0; i < sources.size(); i++) {
+            const auto& source = sources[i];
+            _meshes.emplace_back(source.vertices, source.vertices_count,
+                source.indices, source.indices_count,
+                loadTextures(*textures[i]), source.bounds, _vertex_format);
+        }
+        ApplyTransforms();
+    }
+
+    // Propagates the node transforms set since the last call.
+    void UpdateTransforms() {
+        if (_scene.Update() > 0) {
+            ApplyTransforms();
+        }
+    }
+
+    // Hands the world transforms of the nodes the last update changed to
+    // their meshes, and moves their bounds along.
+    void ApplyTransforms() {
+        for (size_t i = 0; i < _meshes.size(); i++) {
+            uint32_t node = _mesh_nodes[i];
+            if (!_scene.updated(node)) {
+                continue;
+            }
+            const glm::mat4& world = _scene.world(node);
+            _meshes[i].SetTransform(world);
+            _boxes[i] = Transformed(_local_boxes[i], world);
+            _spheres[i] = Transformed(_local_spheres[i], world);
+        }
+        if (_batches) {
+            _batches->SetTransforms(_meshes);
+        }
     }
 
-    void processNode(aiNode* node, const aiScene* scene) {
+    // Walks the node tree depth first, which is the order of the scene
+    // graph and the order meshes are drawn in. A mesh referenced by
+    // several nodes is collected once per node.
+    void collectNodes(const aiNode* node, int32_t parent, const aiScene* scene,
+        std::vector<aiMesh*>& meshes, std::vector<uint32_t>& mesh_nodes,
+        std::vector<SceneNode>& nodes) {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({ parent, ToMat4(node->mTransformation) });
+
         for (size_t i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            _meshes.push_back(processMesh(mesh, scene));
+            meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+            mesh_nodes.push_back(index);
         }
 
         for (size_t i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene);
+            collectNodes(node->mChildren[i], static_cast<int32_t>(index), scene,
+                meshes, mesh_nodes, nodes);
         }
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene) {
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
+    // Assimp matrices are row major, GLM ones column major.
+    static glm::mat4 ToMat4(const aiMatrix4x4& m) {
+        glm::mat4 result;
+        result[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+        result[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+        result[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+        result[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+        return result;
+    }
+
+    // Runs on the pool: only reads the scene and writes its own MeshData.
+    static MeshData processMesh(const aiMesh* mesh, const aiScene* scene) {
+        MeshData data;
+        data.bounds.min = glm::vec3(std::numeric_limits<float>::max());
+        data.bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
 
+        data.vertices.resize(mesh->mNumVertices);
         for (size_t i = 0; i < mesh->mNumVertices; i++) {
-            Vertex vertex;
+            Vertex& vertex = data.vertices[i];
 
             vertex.Position = glm::vec3(
                 mesh->mVertices[i].x, mesh->mVertices[i].y,
                 mesh->mVertices[i].z
             );
+            data.bounds.min = glm::min(data.bounds.min, vertex.Position);
+            data.bounds.max = glm::max(data.bounds.max, vertex.Position);
 
             if (mesh->HasNormals()) {
                 vertex.Normal = glm::vec3(
@@ -124,50 +438,62 @@ private:
             } else {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
             }
-
-            vertices.push_back(vertex);
         }
 
+        // Faces are triangles after aiProcess_Triangulate, except for point
+        // and line primitives which are smaller.
+        data.indices.reserve(mesh->mNumFaces * 3);
         for (size_t i = 0; i < mesh->mNumFaces; i++) {
-            aiFace& face = mesh->mFaces[i];
-            for (size_t j = 0; j < face.mNumIndices; j++) {
-                indices.push_back(face.mIndices[j]);
-            }
+            const aiFace& face = mesh->mFaces[i];
+            data.indices.insert(data.indices.end(),
+                face.mIndices, face.mIndices + face.mNumIndices);
         }
 
+        data.sphere = BoundingSphereOf(data.bounds, data.vertices.data(),
+            data.vertices.size(), sizeof(Vertex));
+
         if (mesh->mMaterialIndex >= 0) {
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture> diffuseMaps = loadMaterialTexture(material,
+            std::vector<TextureRef> diffuseMaps = materialTextures(material,
                 aiTextureType_DIFFUSE, "texture_diffuse");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            std::vector<Texture> specularMaps = loadMaterialTexture(material,
+            data.textures.insert(data.textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+            std::vector<TextureRef> specularMaps = materialTextures(material,
                 aiTextureType_SPECULAR, "texture_specular");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+            data.textures.insert(data.textures.end(), specularMaps.begin(), specularMaps.end());
         }
 
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    std::vector<Texture> loadMaterialTexture(aiMaterial* material,
+    static std::vector<TextureRef> materialTextures(const aiMaterial* material,
         aiTextureType type, const std::string& typeName) {
-        std::vector<Texture> textures;
+        std::vector<TextureRef> textures;
         for (size_t i = 0; i < material->GetTextureCount(type); i++) {
             aiString str;
             material->GetTexture(type, i, &str);
+            textures.push_back({ typeName, std::string(str.C_Str()) });
+        }
+        return textures;
+    }
 
-            std::string texturePath = std::string(str.C_Str());
-            if (_textures_lookup.find(texturePath) != _textures_lookup.end()) {
-                textures.push_back(_textures_lookup[texturePath]);
+    std::vector<Texture> loadTextures(const std::vector<TextureRef>& refs) {
+        std::vector<Texture> textures;
+        for (const auto& ref: refs) {
+            if (_textures_lookup.find(ref.path) != _textures_lookup.end()) {
+                textures.push_back(_textures_lookup[ref.path]);
                 continue;
             }
 
-            std::string textureAbsolutePath = _directory + "/" + texturePath;
+            std::string textureAbsolutePath = _directory + "/" + ref.path;
+            TextureCache::Handle handle = TextureCache::Shared().Acquire(textureAbsolutePath);
+            _texture_handles.push_back(handle);
+
             Texture texture;
-            texture.id = BindTexture(textureAbsolutePath);
-            texture.type = typeName;
-            texture.path = texturePath;
+            texture.id = handle->id();
+            texture.type = ref.type;
+            texture.path = ref.path;
 
-            _textures_lookup[texturePath] = texture;
+            _textures_lookup[ref.path] = texture;
             textures.push_back(texture);
         }
 
@@ -0,0 +1,200 @@
+#ifndef __RENDER_QUEUE_H__
+#define __RENDER_QUEUE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include <glad.h>
+
+#include "mesh.h"
+#include "shader.h"
+
+// Collects the draws of a frame and submits them sorted by a 64-bit key,
+// so that draws sharing a program, a material and a VAO are consecutive,
+// and skips every bind or uniform upload that would not change anything.
+//
+// Key layout, most significant first:
+//
+//   | program 12 | material 20 | VAO 16 | depth 16 |
+//
+// The material is a hash of the texture objects, a collision only costs
+// ordering, never correctness: the binds compare the actual objects. Depth
+// is expected in [0, 1] and sorts front to back within a state bucket.
+//
+// The shadowed state is reset on every Flush(), since the rest of the
+// frame may change it behind the queue's back.
+class RenderQueue {
+public:
+    struct Stats {
+        size_t draws = 0;
+        size_t program_binds = 0;
+        size_t program_binds_skipped = 0;
+        size_t vao_binds = 0;
+        size_t vao_binds_skipped = 0;
+        size_t texture_binds = 0;
+        size_t texture_binds_skipped = 0;
+        size_t uniform_sets = 0;
+        size_t uniform_sets_skipped = 0;
+    };
+
+    static uint64_t MakeKey(unsigned int program, uint32_t material,
+                            unsigned int vao, float depth) {
+        uint64_t quantized_depth = static_cast<uint64_t>(
+            std::min(std::max(depth, 0.0f), 1.0f) * 0xFFFF);
+        return (uint64_t(program & 0xFFF) << 52)
+            | (uint64_t(material & 0xFFFFF) << 32)
+            | (uint64_t(vao & 0xFFFF) << 16)
+            | quantized_depth;
+    }
+
+    // vao is the one the mesh is drawn from (its own or the arena's).
+    void Submit(Shader& shader, const Mesh& mesh, unsigned int vao, float depth) {
+        _items.push_back({ MakeKey(shader.ID, MaterialHash(mesh), vao, depth),
+            &shader, &mesh, vao });
+    }
+
+    // Draws everything submitted since the last Flush and clears the queue.
+    void Flush() {
+        std::sort(_items.begin(), _items.end(), [](const Item& a, const Item& b) {
+            return a.key < b.key;
+        });
+
+        _stats = Stats();
+        _program = 0;
+        _vao = 0;
+        _textures.clear();
+        _programs.clear();
+
+        for (const auto& item: _items) {
+            if (item.shader->ID != _program) {
+                item.shader->use();
+                _program = item.shader->ID;
+                _stats.program_binds++;
+            } else {
+                _stats.program_binds_skipped++;
+            }
+
+            if (item.vao != _vao) {
+                glBindVertexArray(item.vao);
+                _vao = item.vao;
+                _stats.vao_binds++;
+            } else {
+                _stats.vao_binds_skipped++;
+            }
+
+            auto state = _programs.try_emplace(_program);
+            ProgramState& program = state.first->second;
+            if (state.second) {
+                program.uniforms = MeshUniforms::Resolve(*item.shader);
+            }
+            const Mesh& mesh = *item.mesh;
+            SetVec3(*item.shader, program.position_scale, program.uniforms.position_scale,
+                    mesh.positionScale());
+            SetVec3(*item.shader, program.position_offset, program.uniforms.position_offset,
+                    mesh.positionOffset());
+
+            const auto& textures = mesh.textures();
+            const auto& sampler_slots = mesh.samplerSlots();
+            if (_textures.size() < textures.size()) {
+                _textures.resize(textures.size(), 0);
+            }
+            for (size_t i = 0; i < textures.size(); i++) {
+                uint8_t slot = sampler_slots[i];
+                if (slot != kNoSamplerSlot) {
+                    if (program.sampler_units[slot] != static_cast<int>(i)) {
+                        item.shader->setInt(program.uniforms.samplers[slot], i);
+                        program.sampler_units[slot] = static_cast<int>(i);
+                        _stats.uniform_sets++;
+                    } else {
+                        _stats.uniform_sets_skipped++;
+                    }
+                }
+
+                if (_textures[i] != textures[i].id) {
+                    glActiveTexture(GL_TEXTURE0 + i);
+                    glBindTexture(textures[i].target, textures[i].id);
+                    _textures[i] = textures[i].id;
+                    _stats.texture_binds++;
+                } else {
+                    _stats.texture_binds_skipped++;
+                }
+            }
+
+            // Packed textures differ by layer only, which is no bind. Node
+            // transforms are constant attributes, no uniform either.
+            mesh.BindLayers();
+            mesh.BindTransform();
+            mesh.DrawRange();
+            _stats.draws++;
+        }
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        _items.clear();
+    }
+
+    // Counters of the last Flush.
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        Shader* shader;
+        const Mesh* mesh;
+        unsigned int vao;
+    };
+
+    struct ShadowedVec3 {
+        bool set = false;
+        glm::vec3 value;
+    };
+
+    // Uniform values last uploaded to a program during the current Flush.
+    struct ProgramState {
+        MeshUniforms uniforms;
+        // Unit last set on every sampler slot, -1 before the first set.
+        int sampler_units[kSamplerSlots];
+        ShadowedVec3 position_scale;
+        ShadowedVec3 position_offset;
+
+        ProgramState() noexcept {
+            std::fill(std::begin(sampler_units), std::end(sampler_units), -1);
+        }
+    };
+
+    std::vector<Item> _items;
+    Stats _stats;
+    unsigned int _program = 0;
+    unsigned int _vao = 0;
+    // Texture bound to each unit, by unit.
+    std::vector<unsigned int> _textures;
+    std::unordered_map<unsigned int, ProgramState> _programs;
+
+    void SetVec3(const Shader& shader, ShadowedVec3& shadow,
+                 const UniformHandle<glm::vec3>& handle, const glm::vec3& value) {
+        if (shadow.set && shadow.value == value) {
+            _stats.uniform_sets_skipped++;
+            return;
+        }
+        shader.set(handle, value);
+        shadow.set = true;
+        shadow.value = value;
+        _stats.uniform_sets++;
+    }
+
+    static uint32_t MaterialHash(const Mesh& mesh) {
+        size_t hash = 0;
+        for (const auto& texture: mesh.textures()) {
+            hash = hash * 31 + std::hash<unsigned int>()(texture.id);
+        }
+        return static_cast<uint32_t>(hash);
+    }
+};
+
+#endif  // __RENDER_QUEUE_H__
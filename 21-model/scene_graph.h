@@ -0,0 +1,136 @@
+#ifndef __SCENE_GRAPH_H__
+#define __SCENE_GRAPH_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "glm.hpp"
+
+// A node of a SceneGraph as it is imported or cached: its parent (an
+// earlier node, or SceneGraph::kNoParent) and its transform relative to it.
+struct SceneNode {
+    int32_t parent;
+    glm::mat4 local;
+};
+
+// Transform hierarchy of a model, stored as structure of arrays in depth
+// first order, so that every parent comes before its children and the
+// subtree of a node is the contiguous range [node, subtreeEnd(node)).
+//
+// Changing the local transform of a node only marks it dirty. Update()
+// walks the dirty flags and recomputes the world transforms of the dirty
+// subtrees in one forward pass, the rest of the hierarchy is not touched.
+// World transforms are relative to the root's parent, i.e. in model space.
+class SceneGraph {
+public:
+    static constexpr int32_t kNoParent = -1;
+
+    SceneGraph() noexcept : _dirty_count(0) {}
+
+    // nodes have to be in depth first order, see SceneNode.
+    explicit SceneGraph(const std::vector<SceneNode>& nodes) noexcept
+        : _dirty_count(0) {
+        _parents.reserve(nodes.size());
+        _locals.reserve(nodes.size());
+        for (const auto& node: nodes) {
+            _parents.push_back(node.parent);
+            _locals.push_back(node.local);
+        }
+        _worlds.resize(nodes.size());
+        _dirty.assign(nodes.size(), 0);
+        _updated.assign(nodes.size(), 1);
+
+        // A subtree ends where the next node with a parent outside of it
+        // starts, i.e. at the first later node which is not a descendant.
+        _subtree_ends.assign(nodes.size(), static_cast<uint32_t>(nodes.size()));
+        std::vector<uint32_t> open;
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            while (!open.empty() && static_cast<int32_t>(open.back()) != _parents[i]) {
+                _subtree_ends[open.back()] = i;
+                open.pop_back();
+            }
+            open.push_back(i);
+        }
+
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            _worlds[i] = _parents[i] == kNoParent
+                ? _locals[i] : _worlds[_parents[i]] * _locals[i];
+        }
+    }
+
+    inline size_t size() const {
+        return _parents.size();
+    }
+
+    inline int32_t parent(uint32_t node) const {
+        return _parents[node];
+    }
+
+    inline uint32_t subtreeEnd(uint32_t node) const {
+        return _subtree_ends[node];
+    }
+
+    inline const glm::mat4& local(uint32_t node) const {
+        return _locals[node];
+    }
+
+    // As of the last Update.
+    inline const glm::mat4& world(uint32_t node) const {
+        return _worlds[node];
+    }
+
+    // Whether the last Update changed the world transform of node. All
+    // nodes count as changed before the first one.
+    inline bool updated(uint32_t node) const {
+        return _updated[node];
+    }
+
+    void SetLocal(uint32_t node, const glm::mat4& local) {
+        _locals[node] = local;
+        if (!_dirty[node]) {
+            _dirty[node] = 1;
+            _dirty_count++;
+        }
+    }
+
+    // Recomputes the world transforms of the dirty nodes and their
+    // descendants. Returns the number of nodes updated.
+    size_t Update() {
+        std::fill(_updated.begin(), _updated.end(), 0);
+        if (_dirty_count == 0) {
+            return 0;
+        }
+
+        size_t updated = 0;
+        for (uint32_t i = 0; i < _parents.size();) {
+            if (!_dirty[i]) {
+                i++;
+                continue;
+            }
+            // Dirty nodes in the subtree are covered as well.
+            uint32_t end = _subtree_ends[i];
+            for (uint32_t j = i; j < end; j++) {
+                _worlds[j] = _parents[j] == kNoParent
+                    ? _locals[j] : _worlds[_parents[j]] * _locals[j];
+                _dirty[j] = 0;
+                _updated[j] = 1;
+            }
+            updated += end - i;
+            i = end;
+        }
+        _dirty_count = 0;
+        return updated;
+    }
+
+private:
+    std::vector<int32_t> _parents;
+    std::vector<uint32_t> _subtree_ends;
+    std::vector<glm::mat4> _locals;
+    std::vector<glm::mat4> _worlds;
+    std::vector<uint8_t> _dirty;
+    std::vector<uint8_t> _updated;
+    size_t _dirty_count;
+};
+
+#endif  // __SCENE_GRAPH_H__
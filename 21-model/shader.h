@@ -2,12 +2,105 @@
 #define __SHADER_H__
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <type_traits>
+#include <unordered_map>
 
 #include <glad.h>
 
+// Describes how a C++ type maps onto GLSL uniforms: which GL types it may be
+// bound to and how to upload it.
+template<typename T>
+struct UniformTraits;
+
+template<>
+struct UniformTraits<bool> {
+    static bool accepts(GLenum type) {
+        return type == GL_BOOL;
+    }
+
+    static void upload(int location, bool value) {
+        glUniform1i(location, static_cast<int>(value));
+    }
+};
+
+template<>
+struct UniformTraits<int> {
+    static bool accepts(GLenum type) {
+        switch (type) {
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_ARRAY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static void upload(int location, int value) {
+        glUniform1i(location, value);
+    }
+};
+
+template<>
+struct UniformTraits<float> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT;
+    }
+
+    static void upload(int location, float value) {
+        glUniform1f(location, value);
+    }
+};
+
+template<>
+struct UniformTraits<glm::vec3> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT_VEC3;
+    }
+
+    static void upload(int location, const glm::vec3& value) {
+        glUniform3f(location, value.x, value.y, value.z);
+    }
+};
+
+template<>
+struct UniformTraits<glm::mat4> {
+    static bool accepts(GLenum type) {
+        return type == GL_FLOAT_MAT4;
+    }
+
+    static void upload(int location, const glm::mat4& value) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+};
+
+// A uniform location tagged with its C++ type. Resolve it once through
+// Shader::uniform<T>() and keep it, then upload with Shader::set().
+template<typename T>
+class UniformHandle {
+public:
+    UniformHandle() noexcept : _location(-1) {}
+
+    explicit UniformHandle(int location) noexcept : _location(location) {}
+
+    inline int location() const {
+        return _location;
+    }
+
+    inline bool valid() const {
+        return _location >= 0;
+    }
+
+private:
+    int _location;
+};
+
 class Shader {
 public:
     unsigned int ID;
@@ -80,30 +173,148 @@ public:
 
         glDeleteShader(vid);
         glDeleteShader(fid);
+
+        loadUniformLocations();
     }
 
     void use() {
         glUseProgram(ID);
     }
 
+    // Returns the location of an active uniform, or -1 if the program
+    // does not use it (same contract as glGetUniformLocation).
+    int uniformLocation(const std::string& name) const {
+        auto it = _uniforms.find(name);
+        if (it == _uniforms.end()) {
+            return -1;
+        }
+        return it->second.location;
+    }
+
+    // Resolves a typed handle. Uniforms the program does not use give an
+    // invalid handle (uploads to it are ignored by GL), while a uniform
+    // declared with a type T cannot be bound to is a programming error.
+    template<typename T>
+    UniformHandle<T> uniform(const std::string& name) const {
+        auto it = _uniforms.find(name);
+        if (it == _uniforms.end()) {
+            return UniformHandle<T>();
+        }
+        if (!UniformTraits<T>::accepts(it->second.type)) {
+            std::cout << "Uniform type mismatch: " << name << std::endl;
+            std::abort();
+        }
+        return UniformHandle<T>(it->second.location);
+    }
+
+    // The value type has to match the handle exactly, so passing a float to
+    // an int uniform (or a vec3 to a mat4 one) does not compile.
+    template<typename T, typename V>
+    void set(const UniformHandle<T>& handle, const V& value) const {
+        static_assert(std::is_same_v<T, V>,
+            "Value type does not match the uniform handle type.");
+        UniformTraits<T>::upload(handle.location(), value);
+    }
+
     void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+        setBool(uniformLocation(name), value);
     }
 
     void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniformLocation(name), value);
     }
 
     void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniformLocation(name), value);
     }
 
     void setVec3(const std::string& name, const glm::vec3& vec) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z);
+        setVec3(uniformLocation(name), vec);
     }
 
     void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(uniformLocation(name), x, y, z);
+    }
+
+    void setMat4(const std::string& name, const glm::mat4& mat) const {
+        setMat4(uniformLocation(name), mat);
+    }
+
+    // Location based setters, meant for the hot paths: resolve the location
+    // once with uniformLocation() and keep it around.
+    void setBool(int location, bool value) const {
+        glUniform1i(location, static_cast<int>(value));
+    }
+
+    void setInt(int location, int value) const {
+        glUniform1i(location, value);
+    }
+
+    void setFloat(int location, float value) const {
+        glUniform1f(location, value);
+    }
+
+    void setVec3(int location, const glm::vec3& vec) const {
+        glUniform3f(location, vec.x, vec.y, vec.z);
+    }
+
+    void setVec3(int location, float x, float y, float z) const {
+        glUniform3f(location, x, y, z);
+    }
+
+    void setMat4(int location, const glm::mat4& mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+private:
+    struct UniformInfo {
+        int location;
+        GLenum type;
+    };
+
+    std::unordered_map<std::string, UniformInfo> _uniforms;
+
+    // Introspects all active uniforms once after link, so that setters never
+    // have to ask the driver for a location again.
+    void loadUniformLocations() {
+        int uniforms_count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniforms_count);
+
+        int max_name_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+        std::vector<char> name_buffer(max_name_length + 1);
+
+        _uniforms.reserve(uniforms_count);
+        for (int i = 0; i < uniforms_count; i++) {
+            int name_length = 0;
+            int size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, name_buffer.size(), &name_length,
+                &size, &type, name_buffer.data());
+
+            std::string name(name_buffer.data(), name_length);
+            int location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0) {
+                // Uniform block members do not have a location.
+                continue;
+            }
+            _uniforms[name] = { location, type };
+
+            // Arrays are reported once as "name[0]", register the bare name
+            // and every element so that "name[i]" lookups hit the table too.
+            const std::string array_suffix = "[0]";
+            if (name.size() > array_suffix.size() &&
+                name.compare(name.size() - array_suffix.size(),
+                    array_suffix.size(), array_suffix) == 0) {
+                std::string base = name.substr(0, name.size() - array_suffix.size());
+                _uniforms[base] = { location, type };
+                for (int j = 1; j < size; j++) {
+                    std::string element = base + "[" + std::to_string(j) + "]";
+                    _uniforms[element] = {
+                        glGetUniformLocation(ID, element.c_str()), type };
+                }
+            }
+        }
     }
 };
 
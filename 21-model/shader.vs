@@ -2,14 +2,24 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
 layout (location = 2) in vec2 aTexCoords;
+// Array layer of each texture of the mesh, see kMaterialLayersAttribute.
+layout (location = 3) in ivec4 aMaterialLayers;
+// Transform of the scene graph node of the mesh, see kNodeTransformAttribute.
+layout (location = 4) in mat4 aNodeTransform;
 
 out vec2 TexCoords;
+flat out ivec4 MaterialLayers;
 
 uniform mat4x4 projection;
 uniform mat4x4 view;
 uniform mat4x4 model;
+// Undo the position quantization of the vertex format, see vertex_format.h.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * aNodeTransform
+        * vec4(aPos * positionScale + positionOffset, 1.0);
     TexCoords = aTexCoords;
+    MaterialLayers = aMaterialLayers;
 }
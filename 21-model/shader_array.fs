@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 TexCoords;
+flat in ivec4 MaterialLayers;
+
+out vec4 FragColor;
+
+// Packed by TextureArrays, the layer of the texture comes with the draw
+// (the diffuse map is the first texture of a mesh).
+uniform sampler2DArray texture_diffuse1;
+
+void main() {
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, MaterialLayers.x));
+}
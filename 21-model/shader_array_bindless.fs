@@ -0,0 +1,15 @@
+#version 330 core
+#extension GL_ARB_bindless_texture : require
+in vec2 TexCoords;
+flat in ivec4 MaterialLayers;
+
+out vec4 FragColor;
+
+// shader_array.fs for drivers with ARB_bindless_texture: the arrays packed
+// by TextureArrays are resident, Mesh::Bind sets their handle on the
+// sampler instead of binding them to a unit.
+layout(bindless_sampler) uniform sampler2DArray texture_diffuse1;
+
+void main() {
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, MaterialLayers.x));
+}
@@ -0,0 +1,169 @@
+#ifndef __TEXTURE_ARRAY_H__
+#define __TEXTURE_ARRAY_H__
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glad.h>
+
+// Material textures copied into GL_TEXTURE_2D_ARRAY layers, one array per
+// texture size, so that meshes using different textures of the same size
+// share a single bind and only differ by a layer index per draw.
+//
+// Layers are copied on the GPU with glBlitFramebuffer, which is core 3.3
+// and (unlike glCopyImageSubData) converts RED and RGB sources to the RGBA8
+// arrays. The sampler parameters of the first texture of an array are used
+// for the whole array and its mipmaps are generated again. The sources
+// have to be fully uploaded (not TextureLoader placeholders), they are only
+// read and can be deleted afterwards.
+//
+// With ARB_bindless_texture every array also gets a resident handle, set
+// on the sampler uniform instead of binding a texture unit.
+class TextureArrays {
+public:
+    struct Layer {
+        unsigned int array;
+        GLint layer;
+        // 0 without ARB_bindless_texture.
+        GLuint64 handle;
+    };
+
+    TextureArrays(const std::vector<unsigned int>& textures) noexcept
+        : _bindless(false), _bytes(0) {
+#ifdef GL_ARB_bindless_texture
+        _bindless = GLAD_GL_ARB_bindless_texture;
+#endif
+
+        // Textures by size, each appears once.
+        std::map<std::pair<GLint, GLint>, std::vector<unsigned int>> sizes;
+        for (unsigned int texture: textures) {
+            if (_layers.find(texture) != _layers.end()) {
+                continue;
+            }
+            GLint width, height;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+            std::vector<unsigned int>& layers = sizes[{ width, height }];
+            _layers[texture] = { 0, static_cast<GLint>(layers.size()), 0 };
+            layers.push_back(texture);
+        }
+
+        unsigned int framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+        for (const auto& size: sizes) {
+            GLint width = size.first.first;
+            GLint height = size.first.second;
+            const std::vector<unsigned int>& layers = size.second;
+            unsigned int array = CreateArray(layers.front(), width, height, layers.size());
+
+            for (unsigned int texture: layers) {
+                Layer& layer = _layers[texture];
+                layer.array = array;
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                    GL_TEXTURE_2D, texture, 0);
+                glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                    array, 0, layer.layer);
+                glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+            GLuint64 handle = 0;
+#ifdef GL_ARB_bindless_texture
+            if (_bindless) {
+                handle = glGetTextureHandleARB(array);
+                glMakeTextureHandleResidentARB(handle);
+            }
+#endif
+            for (unsigned int texture: layers) {
+                _layers[texture].handle = handle;
+            }
+            _arrays.push_back({ array, handle });
+            // Level 0 and its mipmaps, a third more.
+            _bytes += static_cast<size_t>(width) * height * 4 * layers.size() * 4 / 3;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    TextureArrays(const TextureArrays&) = delete;
+    TextureArrays& operator=(const TextureArrays&) = delete;
+
+    ~TextureArrays() {
+        for (const auto& array: _arrays) {
+#ifdef GL_ARB_bindless_texture
+            if (array.handle) {
+                glMakeTextureHandleNonResidentARB(array.handle);
+            }
+#endif
+            glDeleteTextures(1, &array.id);
+        }
+    }
+
+    // Where a texture given to the constructor went, nullptr for others.
+    const Layer* Find(unsigned int texture) const {
+        auto it = _layers.find(texture);
+        return it == _layers.end() ? nullptr : &it->second;
+    }
+
+    // Number of arrays, one per distinct texture size.
+    inline size_t size() const {
+        return _arrays.size();
+    }
+
+    inline bool bindless() const {
+        return _bindless;
+    }
+
+    // Memory taken by the arrays, mipmaps included.
+    inline size_t bytes() const {
+        return _bytes;
+    }
+
+private:
+    struct Array {
+        unsigned int id;
+        GLuint64 handle;
+    };
+
+    std::vector<Array> _arrays;
+    std::unordered_map<unsigned int, Layer> _layers;
+    bool _bindless;
+    size_t _bytes;
+
+    // An empty RGBA8 array sampled like source.
+    static unsigned int CreateArray(unsigned int source, GLint width, GLint height,
+                                    size_t layers) {
+        GLint wrap_s, wrap_t, min_filter, mag_filter;
+        glBindTexture(GL_TEXTURE_2D, source);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrap_s);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrap_t);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &min_filter);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &mag_filter);
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap_s);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap_t);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, min_filter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, mag_filter);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height,
+            static_cast<GLsizei>(layers), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        return array;
+    }
+};
+
+#endif  // __TEXTURE_ARRAY_H__
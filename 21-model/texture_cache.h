@@ -0,0 +1,155 @@
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include <glad.h>
+
+#include "texture_loader.h"
+
+// Process wide cache of the textures loaded from disk, so that models
+// sharing an image (or the same model loaded twice) decode and upload it
+// once.
+//
+// Textures are keyed by their canonical path and sampler. Acquire() hands
+// out a shared handle; the GL texture is deleted with the last handle, so
+// the owners have to release them while the context is current. Only
+// meant to be used from the GL thread.
+class TextureCache {
+public:
+    class Entry {
+    public:
+        Entry(TextureCache& cache, unsigned int id, std::string path) noexcept
+            : _cache(cache), _id(id), _path(std::move(path)) {}
+
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        ~Entry() {
+            _cache._loader.Cancel(_id);
+            glDeleteTextures(1, &_id);
+        }
+
+        inline unsigned int id() const {
+            return _id;
+        }
+
+        inline const std::string& path() const {
+            return _path;
+        }
+
+    private:
+        TextureCache& _cache;
+        unsigned int _id;
+        std::string _path;
+    };
+
+    using Handle = std::shared_ptr<const Entry>;
+
+    TextureCache() noexcept : _hits(0), _misses(0) {}
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    static TextureCache& Shared() {
+        static TextureCache cache;
+        return cache;
+    }
+
+    Handle Acquire(const std::string& path,
+                   const TextureSampler& sampler = TextureSampler()) {
+        Key key = { Canonical(path), sampler };
+        auto it = _entries.find(key);
+        if (it != _entries.end()) {
+            if (Handle handle = it->second.lock()) {
+                _hits++;
+                return handle;
+            }
+        }
+
+        _misses++;
+        Prune();
+        Handle handle = std::make_shared<Entry>(*this,
+            _loader.Load(key.path, sampler), key.path);
+        _entries[key] = handle;
+        return handle;
+    }
+
+    // See TextureLoader::Upload().
+    size_t Upload(std::chrono::microseconds budget) {
+        return _loader.Upload(budget);
+    }
+
+    void Finish() {
+        _loader.Finish();
+    }
+
+    inline PixelUploadStats uploadStats() const {
+        return _loader.stats();
+    }
+
+    inline size_t hits() const {
+        return _hits;
+    }
+
+    inline size_t misses() const {
+        return _misses;
+    }
+
+    // Number of textures currently alive.
+    size_t size() const {
+        size_t alive = 0;
+        for (const auto& entry: _entries) {
+            alive += entry.second.expired() ? 0 : 1;
+        }
+        return alive;
+    }
+
+private:
+    struct Key {
+        std::string path;
+        TextureSampler sampler;
+
+        bool operator==(const Key& other) const {
+            return path == other.path && sampler == other.sampler;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = std::hash<std::string>()(key.path);
+            for (GLint value: { key.sampler.wrap_s, key.sampler.wrap_t,
+                                key.sampler.min_filter, key.sampler.mag_filter }) {
+                hash = hash * 31 + std::hash<GLint>()(value);
+            }
+            return hash;
+        }
+    };
+
+    TextureLoader _loader;
+    std::unordered_map<Key, std::weak_ptr<const Entry>, KeyHash> _entries;
+    size_t _hits;
+    size_t _misses;
+
+    // "./a/../b.png" and "b.png" are the same texture. Paths that do not
+    // resolve are kept as they are, the loader reports them.
+    static std::string Canonical(const std::string& path) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return error ? path : canonical.string();
+    }
+
+    void Prune() {
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            it = it->second.expired() ? _entries.erase(it) : std::next(it);
+        }
+    }
+};
+
+#endif  // __TEXTURE_CACHE_H__
@@ -0,0 +1,194 @@
+#ifndef __TEXTURE_LOADER_H__
+#define __TEXTURE_LOADER_H__
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+
+#include <glad.h>
+
+#include "pixel_upload_ring.h"
+#include "thread_pool.h"
+
+// Texture parameters a texture is created with.
+struct TextureSampler {
+    GLint wrap_s = GL_REPEAT;
+    GLint wrap_t = GL_REPEAT;
+    GLint min_filter = GL_NEAREST;
+    GLint mag_filter = GL_NEAREST;
+
+    bool operator==(const TextureSampler& other) const {
+        return wrap_s == other.wrap_s && wrap_t == other.wrap_t
+            && min_filter == other.min_filter && mag_filter == other.mag_filter;
+    }
+};
+
+// Decodes textures on the shared thread pool and uploads them on the GL
+// thread under a time budget, so that a model with many large maps does
+// not stall its first frames.
+//
+// Load() hands out the GL name right away, backed by a 1x1 placeholder
+// until the decoded image is uploaded by Upload() or Finish(). Uploads go
+// through a PixelUploadRing that only lives while textures are pending.
+// Expects stb_image.h to be included (and implemented) by the includer.
+class TextureLoader {
+public:
+    TextureLoader() noexcept = default;
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    ~TextureLoader() {
+        for (auto& pending: _pending) {
+            Image image = pending.image.get();
+            stbi_image_free(image.data);
+        }
+    }
+
+    unsigned int Load(const std::string& path,
+                      const TextureSampler& sampler = TextureSampler()) {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        UploadPlaceholder(texture, sampler);
+
+        _pending.push_back({ texture, path, ThreadPool::Shared().Submit([path]() {
+            Image image;
+            image.data = stbi_load(path.c_str(), &image.width, &image.height,
+                &image.channels, 0);
+            return image;
+        }) });
+        return texture;
+    }
+
+    // Uploads the images decoded so far, in any order, until the budget is
+    // spent. Never waits for a decode. Returns the number of textures still
+    // pending.
+    size_t Upload(std::chrono::microseconds budget) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto it = _pending.begin(); it != _pending.end();) {
+            if (std::chrono::steady_clock::now() - start >= budget) {
+                break;
+            }
+            if (it->image.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            UploadImage(*it);
+            it = _pending.erase(it);
+        }
+        if (_pending.empty()) {
+            ReleaseRing();
+        }
+        return _pending.size();
+    }
+
+    // Drops the pending upload of texture, if any, e.g. before the texture
+    // is deleted.
+    void Cancel(unsigned int texture) {
+        for (auto it = _pending.begin(); it != _pending.end(); ++it) {
+            if (it->texture == texture) {
+                stbi_image_free(it->image.get().data);
+                _pending.erase(it);
+                return;
+            }
+        }
+    }
+
+    // Waits for and uploads everything still pending.
+    void Finish() {
+        for (auto& pending: _pending) {
+            UploadImage(pending);
+        }
+        _pending.clear();
+        ReleaseRing();
+    }
+
+    inline size_t pending() const {
+        return _pending.size();
+    }
+
+    // Everything uploaded so far, including the rings already released.
+    PixelUploadStats stats() const {
+        PixelUploadStats stats = _released_stats;
+        if (_upload_ring) {
+            stats += _upload_ring->stats();
+        }
+        return stats;
+    }
+
+private:
+    struct Image {
+        unsigned char* data = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+    };
+
+    struct Pending {
+        unsigned int texture;
+        std::string path;
+        std::future<Image> image;
+    };
+
+    std::list<Pending> _pending;
+    std::unique_ptr<PixelUploadRing> _upload_ring;
+    PixelUploadStats _released_stats;
+
+    void ReleaseRing() {
+        if (_upload_ring) {
+            _released_stats += _upload_ring->stats();
+            _upload_ring.reset();
+        }
+    }
+
+    // The sampler is applied right away, the image uploaded later keeps it.
+    static void UploadPlaceholder(unsigned int texture, const TextureSampler& sampler) {
+        static const unsigned char kGrey[] = { 128, 128, 128, 255 };
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrap_s);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrap_t);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.min_filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.mag_filter);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, kGrey);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    void UploadImage(Pending& pending) {
+        Image image = pending.image.get();
+        if (!image.data) {
+            std::cout << "Error while loading texture " << pending.path << std::endl;
+            std::abort();
+        }
+
+        GLenum format = GL_RGB;
+        if (image.channels == 1) {
+            format = GL_RED;
+        } else if (image.channels == 3) {
+            format = GL_RGB;
+        } else if (image.channels == 4) {
+            format = GL_RGBA;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, pending.texture);
+
+        if (!_upload_ring) {
+            _upload_ring = std::make_unique<PixelUploadRing>();
+        }
+        size_t size = static_cast<size_t>(image.width) * image.height * image.channels;
+        const void* pixels = _upload_ring->Stage(image.data, size);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0,
+            format, GL_UNSIGNED_BYTE, pixels);
+        _upload_ring->Commit();
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        stbi_image_free(image.data);
+    }
+};
+
+#endif  // __TEXTURE_LOADER_H__
@@ -0,0 +1,89 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of tasks. Tasks must not
+// touch OpenGL: the context belongs to the main thread.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads_count) : _stopping(false) {
+        if (threads_count == 0) {
+            threads_count = 1;
+        }
+        _workers.reserve(threads_count);
+        for (size_t i = 0; i < threads_count; i++) {
+            _workers.emplace_back(&ThreadPool::run, this);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+        for (auto& worker: _workers) {
+            worker.join();
+        }
+    }
+
+    // Pool shared by the loaders, one worker per hardware thread.
+    static ThreadPool& Shared() {
+        static ThreadPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+    template<typename F>
+    std::future<std::invoke_result_t<F>> Submit(F&& task) {
+        using Result = std::invoke_result_t<F>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        _condition.notify_one();
+        return result;
+    }
+
+    inline size_t size() const {
+        return _workers.size();
+    }
+
+private:
+    bool _stopping;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::queue<std::function<void()>> _tasks;
+    std::vector<std::thread> _workers;
+
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+                if (_stopping && _tasks.empty()) {
+                    return;
+                }
+                task = std::move(_tasks.front());
+                _tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+#endif  // __THREAD_POOL_H__
@@ -0,0 +1,177 @@
+#ifndef __VERTEX_FORMAT_H__
+#define __VERTEX_FORMAT_H__
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/packing.hpp"
+#include <glad.h>
+
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+// Layout of the vertex buffer of a Mesh. Models are imported (and cached)
+// as full float Vertex, the compact formats are packed at upload.
+//
+//   kFloat      32 bytes, Vertex as is.
+//   kCompact    20 bytes, float position, octahedral normal in 2x snorm16,
+//               half float uv.
+//   kQuantized  16 bytes, like kCompact but the position is unorm16 within
+//               the bounds of the mesh.
+//
+// In both compact formats attribute 1 only carries the xy of the encoded
+// normal, shaders that use it decode it with
+//
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+//   n = normalize(n);
+//
+// Quantized positions are mapped back by the positionScale and
+// positionOffset uniforms Mesh::Draw sets (aPos * scale + offset), see
+// MeshUniforms.
+// Half float uvs lose precision on heavily tiled coordinates.
+enum class VertexFormat {
+    kFloat,
+    kCompact,
+    kQuantized,
+};
+
+struct CompactVertex {
+    glm::vec3 Position;
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+};
+
+struct QuantizedVertex {
+    // The fourth component only keeps the vertex 4 byte aligned.
+    uint16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+};
+
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex is not tightly packed.");
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex is not tightly packed.");
+
+// Octahedral encoding of a unit vector: projected on the octahedron
+// |x| + |y| + |z| = 1 and the lower half folded over the upper one.
+inline void PackOctahedral(const glm::vec3& normal, int16_t encoded[2]) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float x = 0.0f;
+    float y = 0.0f;
+    if (length > 0.0f) {
+        x = normal.x / length;
+        y = normal.y / length;
+        if (normal.z < 0.0f) {
+            float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = folded_x;
+            y = folded_y;
+        }
+    }
+    encoded[0] = static_cast<int16_t>(std::round(std::fmin(std::fmax(x, -1.0f), 1.0f) * 32767.0f));
+    encoded[1] = static_cast<int16_t>(std::round(std::fmin(std::fmax(y, -1.0f), 1.0f) * 32767.0f));
+}
+
+inline uint16_t PackUnorm16(float value, float min, float extent) {
+    if (extent <= 0.0f) {
+        return 0;
+    }
+    float normalized = std::fmin(std::fmax((value - min) / extent, 0.0f), 1.0f);
+    return static_cast<uint16_t>(std::round(normalized * 65535.0f));
+}
+
+inline size_t VertexSize(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::kCompact:
+        return sizeof(CompactVertex);
+    case VertexFormat::kQuantized:
+        return sizeof(QuantizedVertex);
+    case VertexFormat::kFloat:
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+inline std::vector<CompactVertex> PackCompact(const Vertex* vertices, size_t count) {
+    std::vector<CompactVertex> packed(count);
+    for (size_t i = 0; i < count; i++) {
+        packed[i].Position = vertices[i].Position;
+        PackOctahedral(vertices[i].Normal, packed[i].Normal);
+        packed[i].TexCoords[0] = glm::packHalf1x16(vertices[i].TexCoords.x);
+        packed[i].TexCoords[1] = glm::packHalf1x16(vertices[i].TexCoords.y);
+    }
+    return packed;
+}
+
+// Positions are quantized within [min, max], the bounds of the vertices.
+inline std::vector<QuantizedVertex> PackQuantized(const Vertex* vertices, size_t count,
+                                                  const glm::vec3& min, const glm::vec3& max) {
+    std::vector<QuantizedVertex> packed(count);
+    for (size_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            packed[i].Position[axis] = PackUnorm16(vertices[i].Position[axis],
+                min[axis], max[axis] - min[axis]);
+        }
+        packed[i].Position[3] = 0;
+        PackOctahedral(vertices[i].Normal, packed[i].Normal);
+        packed[i].TexCoords[0] = glm::packHalf1x16(vertices[i].TexCoords.x);
+        packed[i].TexCoords[1] = glm::packHalf1x16(vertices[i].TexCoords.y);
+    }
+    return packed;
+}
+
+// Packs count vertices into format and writes them at offset (in bytes) of
+// the buffer bound to GL_ARRAY_BUFFER. min and max are the bounds used by
+// kQuantized.
+inline void UploadVertices(GLintptr offset, VertexFormat format,
+                           const Vertex* vertices, size_t count,
+                           const glm::vec3& min, const glm::vec3& max) {
+    if (format == VertexFormat::kCompact) {
+        std::vector<CompactVertex> packed = PackCompact(vertices, count);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(CompactVertex), packed.data());
+    } else if (format == VertexFormat::kQuantized) {
+        std::vector<QuantizedVertex> packed = PackQuantized(vertices, count, min, max);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(QuantizedVertex), packed.data());
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(Vertex), vertices);
+    }
+}
+
+// Points attributes 0 (position), 1 (normal) and 2 (uv) of the bound VAO
+// at the bound GL_ARRAY_BUFFER.
+inline void SetupVertexAttributes(VertexFormat format) {
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    if (format == VertexFormat::kCompact) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertex),
+            reinterpret_cast<void*>(offsetof(CompactVertex, Position)));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex),
+            reinterpret_cast<void*>(offsetof(CompactVertex, Normal)));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex),
+            reinterpret_cast<void*>(offsetof(CompactVertex, TexCoords)));
+    } else if (format == VertexFormat::kQuantized) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex),
+            reinterpret_cast<void*>(offsetof(QuantizedVertex, Position)));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex),
+            reinterpret_cast<void*>(offsetof(QuantizedVertex, Normal)));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(QuantizedVertex),
+            reinterpret_cast<void*>(offsetof(QuantizedVertex, TexCoords)));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            reinterpret_cast<void*>(offsetof(Vertex, Position)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            reinterpret_cast<void*>(offsetof(Vertex, Normal)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            reinterpret_cast<void*>(offsetof(Vertex, TexCoords)));
+    }
+}
+
+#endif  // __VERTEX_FORMAT_H__
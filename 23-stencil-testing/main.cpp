@@ -8,7 +8,10 @@
 #include <gtc/type_ptr.hpp>
 
 #include "shader.h"
+#include "shader_library.h"
 #include "camera.h"
+#include "uniform_buffer.h"
+#include "gl_state_cache.h"
 
 #include <iostream>
 
@@ -78,8 +81,14 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader shader("shader.vs", "shader.fs");
-    Shader outline("shader.vs", "shader_outline.fs");
+    // Both programs compile while the buffers and textures are set up,
+    // they are only waited for right before the shader configuration.
+    ShaderLibrary shaderLibrary;
+    Shader& shader = shaderLibrary.add("shader.vs", "shader.fs");
+    Shader& outline = shaderLibrary.add("shader.vs", "shader_outline.fs");
+
+    // view and projection are shared by both programs through CameraBlock.
+    UniformBuffer<CameraBlock> cameraBuffer;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -167,15 +176,22 @@ int main() {
     unsigned int cubeTexture  = loadTexture("marble.jpg");
     unsigned int floorTexture = loadTexture("metal.png");
 
+    shaderLibrary.wait();
+
     // shader configuration
     // --------------------
-    shader.use();
+    // The render loop sets its whole state every frame, through the cache
+    // only what differs from the previous draw reaches the driver.
+    GLStateCache glState;
+    double statsTime = glfwGetTime();
+
+    glState.UseProgram(shader.ID);
     shader.setInt("texture1", 0);
 
     // render loop
     // -----------
     while(!glfwWindowShouldClose(window)) {
-        glEnable(GL_DEPTH_TEST);
+        glState.Enable(GL_DEPTH_TEST);
 
         // per-frame time logic
         // --------------------
@@ -193,28 +209,19 @@ int main() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        shader.use();
-
         glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 view = camera.view();
         glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-
-        outline.use();
+        cameraBuffer.update({ camera.view(), projection });
 
-        outline.setMat4("view", view);
-        outline.setMat4("projection", projection);
-    
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glStencilMask(0xFF);
+        glState.StencilFunc(GL_ALWAYS, 1, 0xFF);
+        glState.StencilMask(0xFF);
 
-        shader.use();
+        glState.UseProgram(shader.ID);
 
         // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 	
+        glState.BindVertexArray(cubeVAO);
+        glState.ActiveTexture(GL_TEXTURE0);
+        glState.BindTexture(GL_TEXTURE_2D, cubeTexture);
         model = glm::translate(model, glm::vec3(-1.0f, 0.001f, -1.0f));
         shader.setMat4("model", model);
         glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -223,25 +230,24 @@ int main() {
         shader.setMat4("model", model);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
-        glStencilMask(0x00);
+        glState.StencilMask(0x00);
 
         // floor
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
+        glState.BindVertexArray(planeVAO);
+        glState.BindTexture(GL_TEXTURE_2D, floorTexture);
         shader.setMat4("model", glm::mat4(1.0f));
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
 
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilMask(0xFF);
-        glDisable(GL_DEPTH_TEST);
+        glState.StencilFunc(GL_NOTEQUAL, 1, 0xFF);
+        glState.StencilMask(0xFF);
+        glState.Disable(GL_DEPTH_TEST);
 
-        outline.use();
+        glState.UseProgram(outline.ID);
 
         // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 
+        glState.BindVertexArray(cubeVAO);
+        glState.ActiveTexture(GL_TEXTURE0);
+        glState.BindTexture(GL_TEXTURE_2D, cubeTexture);
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(-1.0f, 0.001f, -1.0f));
         model = glm::scale(model, glm::vec3(1.2f));
@@ -253,6 +259,13 @@ int main() {
         outline.setMat4("model", model);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
+        GLStateCache::Stats stats = glState.EndFrame();
+        if (currentFrame - statsTime >= 1.0) {
+            std::cout << "GL state calls per frame: " << stats.forwarded << " forwarded, "
+                      << stats.filtered << " filtered" << std::endl;
+            statsTime = currentFrame;
+        }
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
@@ -265,6 +278,7 @@ int main() {
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &planeVBO);
+    glDeleteBuffers(1, &cameraBuffer.ID);
 
     glfwTerminate();
     return 0;
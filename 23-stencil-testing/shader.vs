@@ -4,8 +4,11 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4x4 projection;
-uniform mat4x4 view;
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4x4 model;
 
 void main() {
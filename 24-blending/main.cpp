@@ -9,15 +9,18 @@
 
 #include "shader.h"
 #include "camera.h"
+#include "pixel_upload_ring.h"
+#include "instanced_batch.h"
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void ProcessInput(float dt, GLFWwindow *window);
-unsigned int loadTexture(const char *path);
+unsigned int loadTexture(const char *path, PixelUploadRing& uploadRing);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -77,6 +80,7 @@ int main() {
     // build and compile shaders
     // -------------------------
     Shader shader("shader.vs", "shader.fs");
+    Shader instancedShader("shader_instanced.vs", "shader.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -187,18 +191,35 @@ int main() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glBindVertexArray(0);
+    // The sorted windows are drawn with a single instanced call, instances
+    // are rasterized in order so blending still goes back to front.
+    auto vegetationBatch = std::make_unique<InstancedBatch>(vegetationVAO, 2);
 
     // load textures
     // -------------
-    unsigned int cubeTexture  = loadTexture("marble.jpg");
-    unsigned int floorTexture = loadTexture("metal.png");
-    unsigned int vegetationTexture = loadTexture("grass.png");
-    unsigned int windowTexture = loadTexture("window.png");
+    // The pixels are staged through a PBO ring that is released again before
+    // the render loop.
+    unsigned int cubeTexture, floorTexture, vegetationTexture, windowTexture;
+    {
+        PixelUploadRing uploadRing;
+        cubeTexture  = loadTexture("marble.jpg", uploadRing);
+        floorTexture = loadTexture("metal.png", uploadRing);
+        vegetationTexture = loadTexture("grass.png", uploadRing);
+        windowTexture = loadTexture("window.png", uploadRing);
+
+        const PixelUploadStats& uploads = uploadRing.stats();
+        std::cout << "Textures uploaded: " << uploads.bytes / 1e6 << " MB at "
+                  << uploads.megabytesPerSecond() << " MB/s"
+                  << (uploadRing.persistent() ? " (persistent mapping)" : " (orphaning)")
+                  << std::endl;
+    }
 
     // shader configuration
     // --------------------
     shader.use();
     shader.setInt("texture1", 0);
+    instancedShader.use();
+    instancedShader.setInt("texture1", 0);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -246,7 +267,6 @@ int main() {
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(0);
         // vegetation
-        glBindVertexArray(vegetationVAO);
         glBindTexture(GL_TEXTURE_2D, windowTexture);
 
         std::sort(vegetation.begin(), vegetation.end(), [](const glm::vec3& a, const glm::vec3 b){
@@ -254,12 +274,15 @@ int main() {
             float db = glm::length(camera.position() - b);
             return da > db;
         });
+        vegetationBatch->Clear();
         for (const auto& v: vegetation) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, v);
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            vegetationBatch->Add(glm::translate(glm::mat4(1.0f), v));
         }
+        instancedShader.use();
+        instancedShader.setMat4("view", view);
+        instancedShader.setMat4("projection", projection);
+        vegetationBatch->DrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -273,6 +296,7 @@ int main() {
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &planeVBO);
+    vegetationBatch.reset();
 
     glfwTerminate();
     return 0;
@@ -327,7 +351,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // utility function for loading a 2D texture from file
 // ---------------------------------------------------
-unsigned int loadTexture(char const *path)
+unsigned int loadTexture(char const *path, PixelUploadRing& uploadRing)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -345,7 +369,9 @@ unsigned int loadTexture(char const *path)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        const void* pixels = uploadRing.Stage(data, static_cast<size_t>(width) * height * nrComponents);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        uploadRing.Commit();
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
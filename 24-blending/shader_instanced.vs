@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// Per instance, see instanced_batch.h.
+layout (location = 2) in mat4 aModel;
+
+out vec2 TexCoords;
+
+uniform mat4x4 projection;
+uniform mat4x4 view;
+
+void main() {
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+}
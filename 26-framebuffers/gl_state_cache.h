@@ -0,0 +1,242 @@
+#ifndef __GL_STATE_CACHE_H__
+#define __GL_STATE_CACHE_H__
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#include <glad.h>
+
+// Shadows the GL state a render loop keeps setting (bound program, VAO,
+// framebuffer, textures per unit, capabilities, depth, stencil, blend and
+// cull state) and only forwards the calls that change it.
+//
+// Everything starts unknown, so the first call of each kind always goes
+// through. Code that changes state behind the cache's back (a loader, a
+// library) must be followed by Invalidate(). Calls going through the cache
+// are counted per frame, see EndFrame().
+class GLStateCache {
+public:
+    struct Stats {
+        size_t forwarded = 0;
+        size_t filtered = 0;
+    };
+
+    static constexpr size_t kTextureUnits = 16;
+
+    GLStateCache() noexcept {
+        Invalidate();
+    }
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    void Invalidate() {
+        _program.reset();
+        _vertex_array.reset();
+        _framebuffer.reset();
+        _active_texture.reset();
+        for (auto& unit: _textures) {
+            unit.texture_2d.reset();
+            unit.texture_cube_map.reset();
+        }
+        for (auto& capability: _capabilities) {
+            capability.reset();
+        }
+        _depth_func.reset();
+        _depth_mask.reset();
+        _stencil_func.reset();
+        _stencil_op.reset();
+        _stencil_mask.reset();
+        _blend_func.reset();
+        _cull_face.reset();
+    }
+
+    // Returns the counters of the frame that ends and starts a new one.
+    Stats EndFrame() {
+        Stats stats = _stats;
+        _stats = Stats();
+        return stats;
+    }
+
+    void UseProgram(unsigned int program) {
+        if (Changes(_program, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    void BindVertexArray(unsigned int vertex_array) {
+        if (Changes(_vertex_array, vertex_array)) {
+            glBindVertexArray(vertex_array);
+        }
+    }
+
+    void BindFramebuffer(unsigned int framebuffer) {
+        if (Changes(_framebuffer, framebuffer)) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+    }
+
+    void ActiveTexture(GLenum unit) {
+        if (Changes(_active_texture, unit)) {
+            glActiveTexture(unit);
+        }
+    }
+
+    // Binds to the active unit, like glBindTexture. Only GL_TEXTURE_2D and
+    // GL_TEXTURE_CUBE_MAP are shadowed, other targets are forwarded.
+    void BindTexture(GLenum target, unsigned int texture) {
+        size_t unit = _active_texture ? *_active_texture - GL_TEXTURE0 : kTextureUnits;
+        std::optional<unsigned int>* bound = nullptr;
+        if (unit < kTextureUnits && target == GL_TEXTURE_2D) {
+            bound = &_textures[unit].texture_2d;
+        } else if (unit < kTextureUnits && target == GL_TEXTURE_CUBE_MAP) {
+            bound = &_textures[unit].texture_cube_map;
+        }
+
+        if (!bound || Changes(*bound, texture)) {
+            if (!bound) {
+                _stats.forwarded++;
+            }
+            glBindTexture(target, texture);
+        }
+    }
+
+    void Enable(GLenum capability) {
+        SetCapability(capability, true);
+    }
+
+    void Disable(GLenum capability) {
+        SetCapability(capability, false);
+    }
+
+    void DepthFunc(GLenum func) {
+        if (Changes(_depth_func, func)) {
+            glDepthFunc(func);
+        }
+    }
+
+    void DepthMask(bool enabled) {
+        if (Changes(_depth_mask, enabled)) {
+            glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        }
+    }
+
+    void StencilFunc(GLenum func, GLint ref, GLuint mask) {
+        StencilFuncState state = { func, ref, mask };
+        if (Changes(_stencil_func, state)) {
+            glStencilFunc(func, ref, mask);
+        }
+    }
+
+    void StencilOp(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass) {
+        StencilOpState state = { stencil_fail, depth_fail, depth_pass };
+        if (Changes(_stencil_op, state)) {
+            glStencilOp(stencil_fail, depth_fail, depth_pass);
+        }
+    }
+
+    void StencilMask(GLuint mask) {
+        if (Changes(_stencil_mask, mask)) {
+            glStencilMask(mask);
+        }
+    }
+
+    void BlendFunc(GLenum source, GLenum destination) {
+        BlendFuncState state = { source, destination };
+        if (Changes(_blend_func, state)) {
+            glBlendFunc(source, destination);
+        }
+    }
+
+    void CullFace(GLenum mode) {
+        if (Changes(_cull_face, mode)) {
+            glCullFace(mode);
+        }
+    }
+
+private:
+    // Capabilities shadowed by Enable/Disable, others are forwarded.
+    static constexpr std::array<GLenum, 4> kCapabilities = {
+        GL_DEPTH_TEST, GL_STENCIL_TEST, GL_BLEND, GL_CULL_FACE,
+    };
+
+    struct TextureUnit {
+        std::optional<unsigned int> texture_2d;
+        std::optional<unsigned int> texture_cube_map;
+    };
+
+    struct StencilFuncState {
+        GLenum func;
+        GLint ref;
+        GLuint mask;
+
+        bool operator==(const StencilFuncState& other) const {
+            return func == other.func && ref == other.ref && mask == other.mask;
+        }
+    };
+
+    struct StencilOpState {
+        GLenum stencil_fail;
+        GLenum depth_fail;
+        GLenum depth_pass;
+
+        bool operator==(const StencilOpState& other) const {
+            return stencil_fail == other.stencil_fail && depth_fail == other.depth_fail
+                && depth_pass == other.depth_pass;
+        }
+    };
+
+    struct BlendFuncState {
+        GLenum source;
+        GLenum destination;
+
+        bool operator==(const BlendFuncState& other) const {
+            return source == other.source && destination == other.destination;
+        }
+    };
+
+    // Empty while unknown.
+    std::optional<unsigned int> _program;
+    std::optional<unsigned int> _vertex_array;
+    std::optional<unsigned int> _framebuffer;
+    std::optional<GLenum> _active_texture;
+    std::array<TextureUnit, kTextureUnits> _textures;
+    std::array<std::optional<bool>, kCapabilities.size()> _capabilities;
+    std::optional<GLenum> _depth_func;
+    std::optional<bool> _depth_mask;
+    std::optional<StencilFuncState> _stencil_func;
+    std::optional<StencilOpState> _stencil_op;
+    std::optional<GLuint> _stencil_mask;
+    std::optional<BlendFuncState> _blend_func;
+    std::optional<GLenum> _cull_face;
+    Stats _stats;
+
+    // Updates the shadow, true if the call has to be forwarded.
+    template<typename T>
+    bool Changes(std::optional<T>& shadow, const T& value) {
+        if (shadow && *shadow == value) {
+            _stats.filtered++;
+            return false;
+        }
+        shadow = value;
+        _stats.forwarded++;
+        return true;
+    }
+
+    void SetCapability(GLenum capability, bool enabled) {
+        for (size_t i = 0; i < kCapabilities.size(); i++) {
+            if (kCapabilities[i] != capability) {
+                continue;
+            }
+            if (Changes(_capabilities[i], enabled)) {
+                enabled ? glEnable(capability) : glDisable(capability);
+            }
+            return;
+        }
+        _stats.forwarded++;
+        enabled ? glEnable(capability) : glDisable(capability);
+    }
+};
+
+#endif  // __GL_STATE_CACHE_H__
@@ -12,7 +12,10 @@
 #include <gtc/type_ptr.hpp>
 
 #include "shader.h"
+#include "shader_library.h"
+#include "shader_watcher.h"
 #include "camera.h"
+#include "gl_state_cache.h"
 
 #include <iostream>
 
@@ -82,8 +85,11 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader shader("shader.vs", "shader.fs");
-    Shader quadShader("quad.vs", "quad.fs");
+    // Both programs compile while the buffers and textures are set up,
+    // they are only waited for right before the shader configuration.
+    ShaderLibrary shaderLibrary;
+    Shader& shader = shaderLibrary.add("shader.vs", "shader.fs");
+    Shader& quadShader = shaderLibrary.add("quad.vs", "quad.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -246,17 +252,38 @@ int main() {
     unsigned int cubeTexture  = loadTexture("marble.jpg");
     unsigned int floorTexture = loadTexture("metal.png");
 
+    shaderLibrary.wait();
+
+    // Every bind and state change of the render loop goes through the cache:
+    // the scene is drawn twice per frame with the same state, most of the
+    // second pass is filtered.
+    GLStateCache glState;
+    double statsTime = glfwGetTime();
+
     // shader configuration
     // --------------------
-    shader.use();
-    shader.setInt("texture1", 0);
+    auto configureShaders = [&]() {
+        glState.UseProgram(shader.ID);
+        shader.setInt("texture1", 0);
+
+        glState.UseProgram(quadShader.ID);
+        quadShader.setInt("screenTexture", 0);
+    };
+    configureShaders();
 
-    quadShader.use();
-    quadShader.setInt("screenTexture", 0);
+    // Edits to the .vs/.fs files show up on the next frame.
+    ShaderWatcher shaderWatcher;
+    shaderWatcher.watch(shader);
+    shaderWatcher.watch(quadShader);
 
     // render loop
     // -----------
     while(!glfwWindowShouldClose(window)) {
+        // A rebuilt program starts with default uniform values.
+        if (shaderWatcher.applyPendingReloads() > 0) {
+            configureShaders();
+        }
+
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -270,87 +297,64 @@ int main() {
 
         // render
         // ------
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        shader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 view = camera.view();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 	
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // floor
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        shader.setMat4("model", glm::mat4(1.0f));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
-
-        quadShader.use();
-        glBindVertexArray(quadVAO);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // Draws the scene to the framebuffer, then its color buffer on the
+        // quad of the given VAO.
+        auto renderPass = [&](unsigned int targetVAO, bool clearScreen) {
+            glState.BindFramebuffer(framebuffer);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glState.Enable(GL_DEPTH_TEST);
+
+            glState.UseProgram(shader.ID);
+            glm::mat4 model = glm::mat4(1.0f);
+            glm::mat4 view = camera.view();
+            glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            shader.setMat4("view", view);
+            shader.setMat4("projection", projection);
+            // cubes
+            glState.BindVertexArray(cubeVAO);
+            glState.ActiveTexture(GL_TEXTURE0);
+            glState.BindTexture(GL_TEXTURE_2D, cubeTexture);
+            model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+            shader.setMat4("model", model);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+            shader.setMat4("model", model);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            // floor
+            glState.BindVertexArray(planeVAO);
+            glState.BindTexture(GL_TEXTURE_2D, floorTexture);
+            shader.setMat4("model", glm::mat4(1.0f));
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            glState.BindFramebuffer(0);
+            if (clearScreen) {
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+            glState.Disable(GL_DEPTH_TEST);
+
+            glState.UseProgram(quadShader.ID);
+            glState.BindVertexArray(targetVAO);
+            glState.BindTexture(GL_TEXTURE_2D, texColorBuffer);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        };
+
+        renderPass(quadVAO, true);
 
         // Mirror.
         camera.LookBack();
-
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        shader.use();
-        model = glm::mat4(1.0f);
-        view = camera.view();
-        projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 	
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // floor
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        shader.setMat4("model", glm::mat4(1.0f));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST);
-
-        quadShader.use();
-        glBindVertexArray(mirrorVAO);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
+        renderPass(mirrorVAO, false);
         camera.LookBack();
 
+        GLStateCache::Stats stats = glState.EndFrame();
+        if (currentFrame - statsTime >= 1.0) {
+            std::cout << "GL state calls per frame: " << stats.forwarded << " forwarded, "
+                      << stats.filtered << " filtered" << std::endl;
+            statsTime = currentFrame;
+        }
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
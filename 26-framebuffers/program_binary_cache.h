@@ -0,0 +1,168 @@
+#ifndef __PROGRAM_BINARY_CACHE_H__
+#define __PROGRAM_BINARY_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <filesystem>
+
+#include <glad.h>
+
+// Stores linked programs on disk with glGetProgramBinary and restores them
+// with glProgramBinary, so warm launches skip compiling and linking.
+//
+// Entries are keyed by a hash of the shader sources and of the driver
+// vendor/renderer/version strings: a driver update or an edited shader
+// simply misses the cache. A binary the driver rejects is reported as a
+// miss as well, and the caller falls back to compiling from source.
+class ProgramBinaryCache {
+public:
+    static std::string Key(const std::string& vertex_code,
+                           const std::string& fragment_code) {
+        uint64_t hash = kFnvOffsetBasis;
+        hash = Hash(hash, vertex_code);
+        hash = Hash(hash, fragment_code);
+        hash = Hash(hash, GlString(GL_VENDOR));
+        hash = Hash(hash, GlString(GL_RENDERER));
+        hash = Hash(hash, GlString(GL_VERSION));
+
+        static const char kHexDigits[] = "0123456789abcdef";
+        std::string key(16, '0');
+        for (int i = 15; i >= 0; i--) {
+            key[i] = kHexDigits[hash & 0xF];
+            hash >>= 4;
+        }
+        return key;
+    }
+
+    static bool IsSupported() {
+        int formats_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats_count);
+        return formats_count > 0;
+    }
+
+    // Has to be called before glLinkProgram for Store to work.
+    static void PrepareForStore(unsigned int program) {
+        if (!IsSupported()) {
+            return;
+        }
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // Loads the binary stored under key into program. Returns false if there
+    // is no entry or the driver did not accept it.
+    static bool Load(unsigned int program, const std::string& key) {
+        if (!IsSupported()) {
+            return false;
+        }
+
+        GLenum format;
+        std::vector<char> binary;
+        if (!ReadEntry(key, format, binary)) {
+            return false;
+        }
+
+        // The hint applies to glProgramBinary as well, so that a program
+        // loaded from the cache can be stored again.
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glProgramBinary(program, format, binary.data(), binary.size());
+
+        int status;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        return status;
+    }
+
+    static void Store(unsigned int program, const std::string& key) {
+        if (!IsSupported()) {
+            return;
+        }
+
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        GLenum format;
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(kDirectory, error);
+        std::ofstream file(Path(key), std::ios::binary | std::ios::trunc);
+        if (error || !file) {
+            std::cout << "Failed to write program binary cache entry " << key << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+
+    // Stores program under a scratch key and loads it back into a new
+    // program. False means warm launches will keep compiling from source.
+    // program has to be linked after PrepareForStore.
+    static bool CheckRoundTrip(unsigned int program) {
+        if (!IsSupported()) {
+            return false;
+        }
+
+        const std::string key = "round_trip_check";
+        Store(program, key);
+        unsigned int copy = glCreateProgram();
+        bool hit = Load(copy, key);
+        glDeleteProgram(copy);
+
+        std::error_code error;
+        std::filesystem::remove(Path(key), error);
+        return hit;
+    }
+
+private:
+    static constexpr const char* kDirectory = "shader_cache";
+    static constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+    static constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+    static std::string Path(const std::string& key) {
+        return std::string(kDirectory) + "/" + key + ".bin";
+    }
+
+    // The format the entry was stored with, then the binary up to the end
+    // of the file. istreambuf_iterator leaves no eofbit behind, so only the
+    // format read can be checked on the stream.
+    static bool ReadEntry(const std::string& key, GLenum& format, std::vector<char>& binary) {
+        std::ifstream file(Path(key), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        file.read(reinterpret_cast<char*>(&format), sizeof(format));
+        if (!file.good()) {
+            return false;
+        }
+        binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !binary.empty();
+    }
+
+    static std::string GlString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        if (!value) {
+            return std::string();
+        }
+        return std::string(reinterpret_cast<const char*>(value));
+    }
+
+    // FNV-1a, also mixing in a terminating zero so that ("ab", "c") and
+    // ("a", "bc") do not collide.
+    static uint64_t Hash(uint64_t hash, const std::string& data) {
+        for (char c: data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= kFnvPrime;
+        }
+        return hash * kFnvPrime;
+    }
+};
+
+#endif  // __PROGRAM_BINARY_CACHE_H__
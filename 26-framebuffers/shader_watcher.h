@@ -0,0 +1,191 @@
+#ifndef __SHADER_WATCHER_H__
+#define __SHADER_WATCHER_H__
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "shader.h"
+
+// Hot reload for shader sources.
+//
+// A background thread watches the source files of every registered Shader
+// (inotify on Linux, modification time polling elsewhere) and only records
+// which programs went stale. The programs are rebuilt by
+// applyPendingReloads() on the thread owning the context, which the render
+// loop calls between frames: the new program replaces the old one before
+// the next frame is drawn, and a program that fails to compile keeps
+// running the previous version.
+class ShaderWatcher {
+public:
+    ShaderWatcher() noexcept : _running(true), _inotify_fd(-1) {
+#ifdef __linux__
+        _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify_fd < 0) {
+            std::cout << "inotify is not available, polling shader sources instead." << std::endl;
+        }
+#endif
+        _thread = std::thread(&ShaderWatcher::run, this);
+    }
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    ~ShaderWatcher() {
+        _running = false;
+        _thread.join();
+#ifdef __linux__
+        if (_inotify_fd >= 0) {
+            close(_inotify_fd);
+        }
+#endif
+    }
+
+    // The shader has to outlive the watcher.
+    void watch(Shader& shader) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        addFile(shader.vertexPath(), &shader);
+        addFile(shader.fragmentPath(), &shader);
+    }
+
+    // Rebuilds the programs whose sources changed since the last call.
+    // Returns how many of them were swapped for a new version.
+    int applyPendingReloads() {
+        std::unordered_set<Shader*> pending;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            pending.swap(_pending);
+        }
+
+        int reloaded = 0;
+        for (Shader* shader: pending) {
+            if (shader->reload()) {
+                std::cout << "Reloaded " << shader->vertexPath() << " + "
+                          << shader->fragmentPath() << std::endl;
+                reloaded += 1;
+            } else {
+                std::cout << "Keeping the previous version of " << shader->vertexPath()
+                          << " + " << shader->fragmentPath() << std::endl;
+            }
+        }
+        return reloaded;
+    }
+
+private:
+    static constexpr std::chrono::milliseconds kPollInterval{100};
+
+    std::atomic<bool> _running;
+    int _inotify_fd;
+    std::thread _thread;
+
+    // Everything below is shared with the watcher thread.
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::vector<Shader*>> _files;
+    std::unordered_map<std::string, std::filesystem::file_time_type> _write_times;
+    std::unordered_map<int, std::string> _directories;
+    std::unordered_set<Shader*> _pending;
+
+    static std::string NormalizedPath(const std::string& path) {
+        return std::filesystem::absolute(path).lexically_normal().string();
+    }
+
+    void addFile(const std::string& path, Shader* shader) {
+        std::string file = NormalizedPath(path);
+        _files[file].push_back(shader);
+
+        std::error_code error;
+        _write_times[file] = std::filesystem::last_write_time(file, error);
+
+#ifdef __linux__
+        if (_inotify_fd < 0) {
+            return;
+        }
+
+        // Editors often save by writing a new file and renaming it over the
+        // old one, which drops watches on the file itself: watch its
+        // directory instead.
+        std::string directory = std::filesystem::path(file).parent_path().string();
+        int wd = inotify_add_watch(_inotify_fd, directory.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            std::cout << "Failed to watch " << directory << std::endl;
+            return;
+        }
+        _directories[wd] = directory;
+#endif
+    }
+
+    void markChanged(const std::string& file) {
+        auto it = _files.find(file);
+        if (it == _files.end()) {
+            return;
+        }
+        _pending.insert(it->second.begin(), it->second.end());
+    }
+
+    void run() {
+        while (_running) {
+#ifdef __linux__
+            if (_inotify_fd >= 0) {
+                readEvents();
+                continue;
+            }
+#endif
+            pollWriteTimes();
+            std::this_thread::sleep_for(kPollInterval);
+        }
+    }
+
+#ifdef __linux__
+    void readEvents() {
+        pollfd descriptor = { _inotify_fd, POLLIN, 0 };
+        if (poll(&descriptor, 1, kPollInterval.count()) <= 0) {
+            return;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(_inotify_fd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto it = _directories.find(event->wd);
+                if (it == _directories.end() || event->len == 0) {
+                    continue;
+                }
+                markChanged(it->second + "/" + event->name);
+            }
+        }
+    }
+#endif
+
+    void pollWriteTimes() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& [file, write_time]: _write_times) {
+            std::error_code error;
+            auto current = std::filesystem::last_write_time(file, error);
+            if (error || current == write_time) {
+                continue;
+            }
+            write_time = current;
+            markChanged(file);
+        }
+    }
+};
+
+#endif  // __SHADER_WATCHER_H__
@@ -12,8 +12,12 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
 
 #include "shader.h"
+#include "shader_library.h"
+#include "uniform_buffer.h"
+#include "pixel_upload_ring.h"
 #include "camera.h"
 
 #include <iostream>
@@ -23,7 +27,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void ProcessInput(float dt, GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-unsigned int loadCubemap(const std::vector<std::string>& faces);
+unsigned int loadCubemap(const std::vector<std::string>& faces, PixelUploadRing& uploadRing);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -40,6 +44,8 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 int main() {
+    auto startupBegin = std::chrono::steady_clock::now();
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -82,8 +88,17 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader shader("shader.vs", "shader.fs");
-    Shader skyboxShader("skybox.vs", "skybox.fs");
+    // Both programs compile while the geometry and the skybox are loaded,
+    // they are only waited for right before the shader configuration.
+    auto shaderSubmitBegin = std::chrono::steady_clock::now();
+    ShaderLibrary shaderLibrary;
+    Shader& shader = shaderLibrary.add("shader.vs", "shader.fs");
+    Shader& skyboxShader = shaderLibrary.add("skybox.vs", "skybox.fs");
+    double shaderSubmitMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - shaderSubmitBegin).count();
+
+    // view and projection are shared by both programs through CameraBlock.
+    UniformBuffer<CameraBlock> cameraBuffer;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -193,7 +208,19 @@ int main() {
         "skybox/back.jpg",
     };
 
-    unsigned int skyboxTexture = loadCubemap(faces);
+    // The faces are staged through a PBO ring that is released again before
+    // the render loop.
+    unsigned int skyboxTexture;
+    {
+        PixelUploadRing uploadRing;
+        skyboxTexture = loadCubemap(faces, uploadRing);
+
+        const PixelUploadStats& uploads = uploadRing.stats();
+        std::cout << "Skybox uploaded: " << uploads.bytes / 1e6 << " MB at "
+                  << uploads.megabytesPerSecond() << " MB/s"
+                  << (uploadRing.persistent() ? " (persistent mapping)" : " (orphaning)")
+                  << std::endl;
+    }
 
     // cube VAO
     unsigned int cubeVAO, cubeVBO;
@@ -219,6 +246,22 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glBindVertexArray(0);
 
+    auto shaderWaitBegin = std::chrono::steady_clock::now();
+    shaderLibrary.wait();
+    double shaderWaitMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - shaderWaitBegin).count();
+
+    // Only the time this thread spent on the programs: submitting them and
+    // waiting for what the driver had not finished during the setup above.
+    // Cold launches compile from source, warm ones load the program binary
+    // cache (see program_binary_cache.h).
+    std::cout << "Shaders: " << shaderSubmitMs + shaderWaitMs << " ms ("
+              << shaderSubmitMs << " ms submit, " << shaderWaitMs << " ms wait)" << std::endl;
+    for (const Shader& program: shaderLibrary.shaders()) {
+        std::cout << "Shader " << program.ID
+                  << (program.loadedFromCache() ? ": binary cache" : ": compiled") << std::endl;
+    }
+
     // shader configuration
     // --------------------
     skyboxShader.use();
@@ -227,6 +270,21 @@ int main() {
     shader.use();
     shader.setInt("skybox", 0);
 
+    auto startupEnd = std::chrono::steady_clock::now();
+    std::cout << "Startup: "
+              << std::chrono::duration<double, std::milli>(startupEnd - startupBegin).count()
+              << " ms" << std::endl;
+
+#ifndef NDEBUG
+    // A store followed by a load of the same entry has to hit, or warm
+    // launches never improve on cold ones. Writes a scratch entry, so it
+    // is left out of release builds and of the startup time.
+    if (ProgramBinaryCache::IsSupported() &&
+        !ProgramBinaryCache::CheckRoundTrip(skyboxShader.ID)) {
+        std::cout << "Program binary cache: stored entry failed to load back" << std::endl;
+    }
+#endif
+
     // render loop
     // -----------
     while(!glfwWindowShouldClose(window)) {
@@ -242,6 +300,7 @@ int main() {
         camera.Reposition();
 
         glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        cameraBuffer.update({ camera.view(), projection });
 
         // render
         // ------
@@ -253,9 +312,6 @@ int main() {
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        glm::mat4 view = camera.view();
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
         shader.setMat4("model", model);
         // cubes
         glBindVertexArray(cubeVAO);
@@ -268,10 +324,6 @@ int main() {
         glDepthFunc(GL_LEQUAL);
         skyboxShader.use();
 
-        view = glm::mat4(glm::mat3(camera.view()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
@@ -291,6 +343,7 @@ int main() {
     glDeleteBuffers(1, &cubeVBO);
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
+    glDeleteBuffers(1, &cameraBuffer.ID);
 
     glfwTerminate();
     return 0;
@@ -382,7 +435,7 @@ unsigned int loadTexture(char const *path)
     return textureID;
 }
 
-unsigned int loadCubemap(const std::vector<std::string>& faces) {
+unsigned int loadCubemap(const std::vector<std::string>& faces, PixelUploadRing& uploadRing) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -391,8 +444,10 @@ unsigned int loadCubemap(const std::vector<std::string>& faces) {
     for (size_t i = 0; i < faces.size(); i++) {
         unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channels, 0);
         if (data) {
+            const void* pixels = uploadRing.Stage(data, static_cast<size_t>(width) * height * channels);
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB,
-                width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+                width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+            uploadRing.Commit();
         } else {
             std::cout << "Cubemap failed to load at path: " << faces[i] << std::endl;
         }
@@ -0,0 +1,188 @@
+#ifndef __PIXEL_UPLOAD_RING_H__
+#define __PIXEL_UPLOAD_RING_H__
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+#include <glad.h>
+
+// Bytes handed to glTex*Image through a PixelUploadRing and the time the
+// calling thread spent on them (copy into the buffer plus the GL call).
+struct PixelUploadStats {
+    size_t bytes = 0;
+    double seconds = 0.0;
+
+    inline double megabytesPerSecond() const {
+        return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0;
+    }
+
+    PixelUploadStats& operator+=(const PixelUploadStats& other) {
+        bytes += other.bytes;
+        seconds += other.seconds;
+        return *this;
+    }
+};
+
+// A ring of GL_PIXEL_UNPACK_BUFFER memory that texture uploads are staged
+// through, so that glTexImage2D returns as soon as the pixels are in the
+// buffer and the driver copies them to the texture asynchronously.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently, and
+// every region handed to the GPU is protected by a fence that is only
+// waited on when the ring wraps around to it. Otherwise the buffer is
+// orphaned on wrap and each region is mapped unsynchronized, which lets
+// the driver do the same bookkeeping.
+//
+//   const void* pixels = ring.Stage(data, size);
+//   glTexImage2D(..., pixels);
+//   ring.Commit();
+//
+// Images bigger than the ring are uploaded from client memory. Pixels
+// are expected tightly packed, as returned by stb_image. Like any GL
+// object the ring has to be destroyed while its context is current.
+class PixelUploadRing {
+public:
+    static constexpr size_t kDefaultCapacity = 32 * 1024 * 1024;
+
+    explicit PixelUploadRing(size_t capacity = kDefaultCapacity) noexcept
+        : _capacity(capacity), _head(0), _mapped(nullptr), _persistent(false),
+          _staged_offset(0), _staged_size(0) {
+        glGenBuffers(1, &_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+#ifdef GL_ARB_buffer_storage
+        if (GLAD_GL_ARB_buffer_storage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+                | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, _capacity, nullptr, flags);
+            _mapped = static_cast<unsigned char*>(glMapBufferRange(
+                GL_PIXEL_UNPACK_BUFFER, 0, _capacity, flags));
+            _persistent = _mapped != nullptr;
+        }
+#endif
+        if (!_persistent) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, _capacity, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    PixelUploadRing(const PixelUploadRing&) = delete;
+    PixelUploadRing& operator=(const PixelUploadRing&) = delete;
+
+    ~PixelUploadRing() {
+        for (auto& region: _regions) {
+            glDeleteSync(region.fence);
+        }
+        if (_persistent) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &_buffer);
+    }
+
+    // Copies the pixels into the ring and leaves it bound, returns what to
+    // pass as the pixels argument of the following glTex*Image call.
+    const void* Stage(const void* pixels, size_t size) {
+        _stage_begin = std::chrono::steady_clock::now();
+        _staged_size = size;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (size > _capacity) {
+            return pixels;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+        size_t offset = Allocate(size);
+        if (_persistent) {
+            std::memcpy(_mapped + offset, pixels, size);
+        } else {
+            void* region = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            std::memcpy(region, pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        _staged_offset = offset;
+        return reinterpret_cast<const void*>(offset);
+    }
+
+    // Fences the region of the last Stage() and unbinds the ring.
+    void Commit() {
+        if (_staged_size <= _capacity) {
+            if (_persistent) {
+                _regions.push_back({ _staged_offset,
+                    glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        _stats.bytes += _staged_size;
+        _stats.seconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - _stage_begin).count();
+        _staged_size = 0;
+    }
+
+    inline bool persistent() const {
+        return _persistent;
+    }
+
+    inline const PixelUploadStats& stats() const {
+        return _stats;
+    }
+
+private:
+    // Regions of the persistent mapping the GPU may still be reading.
+    struct Region {
+        size_t begin;
+        GLsync fence;
+    };
+
+    // Offsets are kept aligned so that every pixel format starts on a
+    // boundary the driver can DMA from.
+    static constexpr size_t kAlignment = 64;
+
+    size_t Allocate(size_t size) {
+        if (_head + size > _capacity) {
+            // The tail of the buffer is skipped: retire what is left there
+            // (the oldest regions) before starting over.
+            while (!_regions.empty() && _regions.front().begin >= _head) {
+                Retire();
+            }
+            _head = 0;
+            if (!_persistent) {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, _capacity, nullptr, GL_STREAM_DRAW);
+            }
+        }
+        while (!_regions.empty() && _regions.front().begin >= _head
+                && _regions.front().begin < _head + size) {
+            Retire();
+        }
+
+        size_t offset = _head;
+        _head = (_head + size + kAlignment - 1) & ~(kAlignment - 1);
+        return offset;
+    }
+
+    void Retire() {
+        GLsync fence = _regions.front().fence;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fence);
+        _regions.pop_front();
+    }
+
+    unsigned int _buffer;
+    size_t _capacity;
+    size_t _head;
+    unsigned char* _mapped;
+    bool _persistent;
+    std::deque<Region> _regions;
+
+    size_t _staged_offset;
+    size_t _staged_size;
+    std::chrono::steady_clock::time_point _stage_begin;
+    PixelUploadStats _stats;
+};
+
+#endif  // __PIXEL_UPLOAD_RING_H__
@@ -5,8 +5,11 @@ layout (location = 1) in vec3 aNormal;
 out vec3 Normal;
 out vec3 Position;
 
-uniform mat4x4 projection;
-uniform mat4x4 view;
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4x4 model;
 
 void main() {
@@ -0,0 +1,77 @@
+#ifndef __SHADER_LIBRARY_H__
+#define __SHADER_LIBRARY_H__
+
+#include <deque>
+
+#include <glad.h>
+
+#include "shader.h"
+
+// Loads a batch of programs without serialising on the driver.
+//
+// add() only submits the sources, so the compilation of every program
+// overlaps with the others and with whatever the caller does next (e.g.
+// loading textures). With KHR_parallel_shader_compile the driver compiles
+// on its own threads and poll() finishes programs as they complete;
+// without it the status checks still happen once, at the end, instead of
+// after every compile and link step.
+class ShaderLibrary {
+public:
+    ShaderLibrary() noexcept : _parallel_compile(false) {
+#ifdef GL_KHR_parallel_shader_compile
+        _parallel_compile = GLAD_GL_KHR_parallel_shader_compile;
+        if (_parallel_compile) {
+            // Let the driver pick the number of compiler threads.
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+#endif
+    }
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // The returned reference stays valid for the lifetime of the library,
+    // but the program can only be used once poll() or wait() finished it.
+    Shader& add(const char* vertex_shader_path,
+                const char* fragment_shader_path) {
+        return _shaders.emplace_back(vertex_shader_path,
+            fragment_shader_path, Shader::Deferred());
+    }
+
+    // Finishes the programs the driver is done with, never blocks when
+    // parallel compilation is available. Returns true once all are ready.
+    bool poll() {
+        bool all_finished = true;
+        for (auto& shader: _shaders) {
+            if (shader.finished()) {
+                continue;
+            }
+            if (_parallel_compile && !shader.isReady()) {
+                all_finished = false;
+                continue;
+            }
+            shader.finish();
+        }
+        return all_finished;
+    }
+
+    void wait() {
+        for (auto& shader: _shaders) {
+            shader.finish();
+        }
+    }
+
+    inline bool parallelCompile() const {
+        return _parallel_compile;
+    }
+
+    inline const std::deque<Shader>& shaders() const {
+        return _shaders;
+    }
+
+private:
+    bool _parallel_compile;
+    std::deque<Shader> _shaders;
+};
+
+#endif  // __SHADER_LIBRARY_H__
@@ -3,11 +3,14 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4x4 projection;
-uniform mat4x4 view;
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+};
 
 void main() {
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // Drop the translation so the skybox stays centered on the camera.
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
@@ -0,0 +1,69 @@
+#ifndef __UNIFORM_BUFFER_H__
+#define __UNIFORM_BUFFER_H__
+
+#include <string>
+#include <unordered_map>
+
+#include <glad.h>
+#include "glm.hpp"
+
+// Binding points of the uniform blocks shared between programs. Shader
+// wires every block it finds in this table right after link, so a program
+// only has to declare the block to receive its data.
+enum class UniformBlockBinding : unsigned int {
+    kCamera = 0,
+};
+
+inline const std::unordered_map<std::string, UniformBlockBinding>& UniformBlockBindings() {
+    static const std::unordered_map<std::string, UniformBlockBinding> bindings = {
+        { "CameraBlock", UniformBlockBinding::kCamera },
+    };
+    return bindings;
+}
+
+// Mirrors the std140 layout of
+//
+//   layout (std140) uniform CameraBlock {
+//       mat4 view;
+//       mat4 projection;
+//   };
+//
+// A mat4 is stored as four vec4 columns in std140, exactly like glm::mat4.
+struct CameraBlock {
+    static constexpr UniformBlockBinding kBinding = UniformBlockBinding::kCamera;
+
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+static_assert(sizeof(CameraBlock) == 2 * 16 * sizeof(float),
+    "CameraBlock does not match the std140 layout.");
+
+// A uniform buffer holding one T, bound to T::kBinding for its lifetime.
+// Uploading once per frame replaces the per program glUniform* calls.
+template<typename T>
+class UniformBuffer {
+public:
+    UniformBuffer() noexcept : ID(0) {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER,
+            static_cast<unsigned int>(T::kBinding), ID);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void update(const T& data) const {
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    unsigned int ID;
+};
+
+#endif  // __UNIFORM_BUFFER_H__